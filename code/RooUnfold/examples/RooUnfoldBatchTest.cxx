@@ -0,0 +1,116 @@
+//=====================================================================-*-C++-*-
+// File and Version Information:
+//      $Id$
+//
+// Description:
+//      Check of RooUnfoldBatch: unfolds two independent toy MC distributions,
+//      each with its own response, together with a block-diagonal response
+//      and separately, and compares the unfolded results and covariance matrices.
+//
+//==============================================================================
+
+#if !(defined(__CINT__) || defined(__CLING__)) || defined(__ACLIC__)
+#include <iostream>
+#include <cmath>
+using std::cout;
+using std::endl;
+using std::fabs;
+
+#include "TRandom.h"
+#include "TString.h"
+#include "TH1D.h"
+#include "TVectorD.h"
+#include "TMatrixD.h"
+
+#include "RooUnfoldResponse.h"
+#include "RooUnfoldBayes.h"
+#include "RooUnfoldBatch.h"
+#endif
+
+#include "RooUnfoldCompare.icc"
+
+//==============================================================================
+// Unfold two blocks together and separately
+//==============================================================================
+
+Int_t RooUnfoldBatchTest (Int_t nbins= 40, Int_t niter= 4, Double_t tol= 1e-9)
+{
+  const Int_t nblocks= 2;
+
+  cout << "==================================== TRAIN ====================================" << endl;
+  gRandom->SetSeed (1);
+  RooUnfoldResponse* response[nblocks];
+  for (Int_t b= 0; b<nblocks; b++) {
+    response[b]= new RooUnfoldResponse (nbins, -10.0, 10.0);
+    for (Int_t i= 0; i<1000*nbins; i++) {
+      Double_t xt= gRandom->BreitWigner (0.3, 2.5);
+      Double_t x= smear (xt, b);
+      if (x!=cutdummy)
+        response[b]->Fill (x, xt);
+      else
+        response[b]->Miss (xt);
+    }
+  }
+
+  cout << "==================================== TEST =====================================" << endl;
+  TH1D* hMeas[nblocks];
+  for (Int_t b= 0; b<nblocks; b++) {
+    hMeas[b]= new TH1D (Form ("meas%d", b), "Test Measured", nbins, -10.0, 10.0);
+    for (Int_t i=0; i<(100+50*b)*nbins; i++) {
+      Double_t x= smear (gRandom->Gaus (0.0, 2.0+b), b);
+      if (x!=cutdummy) hMeas[b]->Fill(x);
+    }
+  }
+
+  cout << "==================================== UNFOLD ===================================" << endl;
+  Int_t nfail= 0;
+  for (Int_t dosys= 0; dosys<=1; dosys++) {
+    RooUnfoldBatch batch ("batch", "Batch Unfold");
+    for (Int_t b= 0; b<nblocks; b++) batch.AddBlock (response[b], hMeas[b], Form ("block%d", b));
+    RooUnfold* unf= batch.Setup (RooUnfold::kBayes, niter);
+    if (!unf) {
+      cout << "Batched unfolding set up FAILED" << endl;
+      nfail++;
+      continue;
+    }
+    unf->SetVerbose (0);
+    unf->IncludeSystematics (dosys);
+    batch.Unfold();
+    for (Int_t b= 0; b<nblocks; b++) {
+      RooUnfoldBayes sep (response[b], hMeas[b], niter);
+      sep.SetVerbose (0);
+      sep.IncludeSystematics (dosys);
+      Double_t dr= maxRecoDiff (sep.Vreco(), batch.Vreco(b));
+      Double_t dc= maxCovDiff  (sep.Ereco(), batch.Ereco(b));
+      Bool_t ok= (dr<tol && dc<tol);
+      cout << (dosys ? "Measurement and response errors" : "Measurement errors") << ", " << batch.GetBlockName(b)
+           << ": max relative difference in result " << dr << ", in covariance " << dc
+           << (ok ? "  OK" : "  FAILED") << endl;
+      if (!ok) nfail++;
+    }
+
+    // No covariance between the blocks
+    TMatrixD cov= unf->Ereco();
+    Int_t nt= response[0]->GetNbinsTruth();
+    Double_t cross= 0.0;
+    for (Int_t i= 0; i<nt; i++)
+      for (Int_t j= nt; j<cov.GetNcols(); j++)
+        cross += fabs (cov(i,j));
+    if (cross!=0.0) {
+      cout << "  covariance between blocks " << cross << "  FAILED" << endl;
+      nfail++;
+    }
+  }
+
+  cout << (nfail ? "Batched unfolding FAILED" : "Batched unfolding OK")
+       << " (tolerance " << tol << ")" << endl;
+  for (Int_t b= 0; b<nblocks; b++) {
+    delete hMeas[b];
+    delete response[b];
+  }
+  return nfail;
+}
+
+#ifndef __CINT__
+int main () { return RooUnfoldBatchTest(); }  // Main program when run stand-alone
+#endif
@@ -0,0 +1,91 @@
+//=====================================================================-*-C++-*-
+// File and Version Information:
+//      $Id$
+//
+// Description:
+//      Accuracy check of RooUnfoldBayes::SetFloatStorage: unfolds the same toy MC
+//      with the response kept in double and in single precision, and compares the
+//      unfolded results and covariance matrices.
+//
+//==============================================================================
+
+#if !(defined(__CINT__) || defined(__CLING__)) || defined(__ACLIC__)
+#include <iostream>
+using std::cout;
+using std::endl;
+
+#include "TRandom.h"
+#include "TH1D.h"
+#include "TVectorD.h"
+#include "TMatrixD.h"
+
+#include "RooUnfoldResponse.h"
+#include "RooUnfoldBayes.h"
+#endif
+
+#include "RooUnfoldCompare.icc"
+
+//==============================================================================
+// Compare the double and single precision results
+//==============================================================================
+
+Int_t compare (const char* what, RooUnfoldBayes& ud, RooUnfoldBayes& uf, Double_t tol)
+{
+  Double_t dr= maxRecoDiff (ud.Vreco(), uf.Vreco());
+  Double_t dc= maxCovDiff  (ud.Ereco(), uf.Ereco());
+  Bool_t ok= (dr<tol && dc<tol);
+  cout << what << ": max relative difference in result " << dr << ", in covariance " << dc
+       << (ok ? "  OK" : "  FAILED") << endl;
+  return ok ? 0 : 1;
+}
+
+//==============================================================================
+// Unfold with double and single precision storage
+//==============================================================================
+
+Int_t RooUnfoldFloatTest (Int_t nbins= 200, Int_t niter= 4, Double_t tol= 1e-4)
+{
+  cout << "==================================== TRAIN ====================================" << endl;
+  gRandom->SetSeed (1);
+  RooUnfoldResponse response (nbins, -10.0, 10.0);
+  for (Int_t i= 0; i<1000*nbins; i++) {
+    Double_t xt= gRandom->BreitWigner (0.3, 2.5);
+    Double_t x= smear (xt);
+    if (x!=cutdummy)
+      response.Fill (x, xt);
+    else
+      response.Miss (xt);
+  }
+
+  cout << "==================================== TEST =====================================" << endl;
+  TH1D* hMeas= new TH1D ("meas", "Test Measured", nbins, -10.0, 10.0);
+  for (Int_t i=0; i<100*nbins; i++) {
+    Double_t x= smear (gRandom->Gaus (0.0, 2.0));
+    if (x!=cutdummy) hMeas->Fill(x);
+  }
+
+  cout << "==================================== UNFOLD ===================================" << endl;
+  Int_t nfail= 0;
+  for (Int_t dosys= 0; dosys<=1; dosys++) {
+    RooUnfoldBayes ud (&response, hMeas, niter), uf (&response, hMeas, niter);
+    ud.SetVerbose (0);
+    uf.SetVerbose (0);
+    ud.IncludeSystematics (dosys);
+    uf.IncludeSystematics (dosys);
+    ud.KeepIterations();
+    uf.KeepIterations();
+    uf.SetFloatStorage();
+    nfail += compare (dosys ? "Measurement and response errors" : "Measurement errors", ud, uf, tol);
+    if (niter>1 && ud.RestoreIteration (niter-1) && uf.RestoreIteration (niter-1))
+      nfail += compare ("  restored to one iteration fewer", ud, uf, tol);
+  }
+
+  cout << (nfail ? "Single precision storage FAILED" : "Single precision storage OK")
+       << " (tolerance " << tol << ")" << endl;
+  delete hMeas;
+  return nfail;
+}
+
+#ifndef __CINT__
+int main () { return RooUnfoldFloatTest(); }  // Main program when run stand-alone
+#endif
@@ -79,6 +79,7 @@ END_HTML */
 #include <sstream>
 #include <cmath>
 #include <vector>
+#include <thread>
 
 #include "TClass.h"
 #include "TMatrixD.h"
@@ -90,11 +91,15 @@ END_HTML */
 #include "TVectorD.h"
 #include "TDecompSVD.h"
 #include "TDecompChol.h"
+#include "TMatrixDSym.h"
 #include "TRandom.h"
 #include "TMath.h"
+#include "TROOT.h"
 
 #include "RooUnfoldResponse.h"
 #include "RooUnfoldErrors.h"
+#include "RooUnfoldToys.h"
+#include "RooUnfoldHistView.h"
 // Need subclasses just for RooUnfold::New()
 #include "RooUnfoldBayes.h"
 #include "RooUnfoldSvd.h"
@@ -228,6 +233,8 @@ void RooUnfold::CopyData (const RooUnfold& rhs)
   Setup (rhs.response(), rhs.Hmeasured());
   SetVerbose (rhs.verbose());
   SetNToys   (rhs.NToys());
+  SetNThreads(rhs.NThreads());
+  SetToySeed (rhs.ToySeed());
 }
 
 void RooUnfold::Reset()
@@ -248,6 +255,11 @@ void RooUnfold::Init()
   _dosys= _unfolded= _haveCov= _haveCovMes= _fail= _have_err_mat= _haveErrors= _haveWgt= false;
   _withError= kDefault;
   _NToys=50;
+  _nthreads= 1;
+  _toyseed= 0;
+  _resToy= 0;
+  _errMatVersion= 0;
+  _wgtToyVersion= -1;
   GetSettings();
 }
 
@@ -262,9 +274,17 @@ RooUnfold& RooUnfold::Setup (const RooUnfoldResponse* res, const TH1* meas)
 void RooUnfold::SetMeasured (const TH1* meas)
 {
   // Set measured distribution and errors. RooUnfold does not own the histogram.
+  // Any previous result is discarded, but subclasses may keep quantities derived
+  // from the response matrix, so the same object can be used to unfold many spectra.
   _meas= meas;
   delete _vMes; _vMes= 0;
   delete _eMes; _eMes= 0;
+  _unfolded= _haveCov= _haveWgt= _haveErrors= _have_err_mat= _fail= false;
+  if (!_haveCovMes) {
+    // covariance was only cached from the previous errors
+    delete _covMes; _covMes= 0;
+    delete _covL;   _covL= 0;
+  }
 }
 
 void RooUnfold::SetMeasured (const TVectorD& meas, const TVectorD& err)
@@ -327,6 +347,7 @@ void RooUnfold::SetResponse (const RooUnfoldResponse* res)
   // Set response matrix for unfolding.
   delete _resmine; _resmine= 0;
   _res= res;
+  _resToy= 0;
   _overflow= _res->UseOverflowStatus() ? 1 : 0;
   _nm= _res->GetNbinsMeasured();
   _nt= _res->GetNbinsTruth();
@@ -337,6 +358,15 @@ void RooUnfold::SetResponse (const RooUnfoldResponse* res)
   SetNameTitleDefault();
 }
 
+Bool_t RooUnfold::SetResponseToy (const TMatrixD* /*mres*/)
+{
+  // Unfold with response matrix mres (not owned) in place of the response object's Mresponse(),
+  // eg. a toy filled by RooUnfoldResponse::RunToy(rnd,mres). Set mres=0 to go back to the response object.
+  // The truth, measured, and fakes distributions still come from the response object.
+  // Returns false if the algorithm does not support this, in which case nothing is changed.
+  return kFALSE;
+}
+
 void RooUnfold::SetResponse (RooUnfoldResponse* res, Bool_t takeOwnership)
 {
   // Set response matrix for unfolding, optionally taking ownership of the RooUnfoldResponse object
@@ -393,29 +423,97 @@ void RooUnfold::GetWgt()
 
 void RooUnfold::GetErrMat()
 {
-  // Get covariance matrix from the variation of the results in toy MC tests
+  // Get covariance matrix from the variation of the results in toy MC tests.
+  // The toys are shared between NThreads() threads (see ToyThreads). Each thread unfolds all its toys
+  // with one copy of this object, so anything that only depends on the response is only calculated once
+  // per thread. Toy k is generated from random number stream (ToySeed(),k), so each toy is the same
+  // whatever the number of threads. The covariance only changes by rounding, as the running sums of
+  // the threads are merged in a different order.
   if (_NToys<=1) return;
-  _err_mat.ResizeTo(_nt,_nt);
-  TVectorD xisum (_nt);
-  TMatrixD xijsum(_nt,_nt);
-  for (Int_t k=0; k<_NToys; k++){
-    RooUnfold* unfold= RunToy();
-    const TVectorD& x= unfold->Vreco();
-    for (Int_t i=0; i<_nt;i++){
-      Double_t xi= x[i];
-      xisum[i] += xi;
-      for (Int_t j=0; j<_nt; j++) xijsum(i,j) += xi * x[j];
-    }
-    delete unfold;
+  ULong64_t seed= _toyseed ? _toyseed : gRandom->Integer(kMaxUInt) + 1;
+  Int_t nthreads= ToyThreads (_NToys);
+
+  PrepareToys();
+
+  TString name= GetName();
+  name += "_toy";
+  std::vector<RooUnfold*> unfold (nthreads);
+  std::vector<RooUnfoldWelford> acc (nthreads, RooUnfoldWelford(_nt));
+  for (Int_t t= 0; t<nthreads; t++) {
+    unfold[t]= Clone(name);
+    unfold[t]->SetMeasured (Vmeasured(), Emeasured());  // make the copy's measured histogram here, not in its thread
   }
-  for (Int_t i=0; i<_nt; i++){
-    for (Int_t j=0; j<_nt; j++){
-      _err_mat(i,j)= (xijsum(i,j) - (xisum[i]*xisum[j])/_NToys) / (_NToys-1);
-    }
+  if (nthreads==1) {
+    RunToys (unfold[0], 0, _NToys, seed, &acc[0]);
+  } else {
+    std::vector<std::thread> threads;
+    for (Int_t t= 0; t<nthreads; t++)
+      threads.push_back (std::thread (&RooUnfold::RunToys, this, unfold[t],
+                                      Int_t((Long64_t(t)*_NToys)/nthreads), Int_t((Long64_t(t+1)*_NToys)/nthreads),
+                                      seed, &acc[t]));
+    for (Int_t t= 0; t<nthreads; t++) threads[t].join();
   }
+  for (Int_t t= 0; t<nthreads; t++) {
+    if (t>0) acc[0].Add (acc[t]);
+    delete unfold[t];
+  }
+  acc[0].Covariance (_err_mat);
+  _errMatVersion++;
   _have_err_mat=true;
 }
 
+Int_t RooUnfold::ToyThreads (Int_t njobs, Bool_t copies) const
+{
+  // Number of threads to share njobs toys (or scan points) between: NThreads(), or one per core if 0,
+  // but no more than njobs. ROOT's thread safety is enabled if more than one is used.
+  // If each thread unfolds with a copy of this object (copies=true), only algorithms for which
+  // ToysInThreads() is true use more than one. Always 1 before ROOT 6.06, which did not have
+  // ROOT::EnableThreadSafety().
+  if (copies && !ToysInThreads()) return 1;
+  Int_t nthreads= _nthreads > 0 ? _nthreads : std::thread::hardware_concurrency();
+  if (nthreads > njobs) nthreads= njobs;
+  if (nthreads < 1)     nthreads= 1;
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,6,0)
+  if (nthreads > 1) ROOT::EnableThreadSafety();
+#else
+  nthreads= 1;
+#endif
+  return nthreads;
+}
+
+Bool_t RooUnfold::ToysInThreads() const
+{
+  // True if copies of this object can unfold and give their errors in separate threads at the same time.
+  // Algorithms that create histograms or toggle TH1::AddDirectory while unfolding (eg. RooUnfoldSvd,
+  // RooUnfoldTUnfold, RooUnfoldBinByBin) must not, so this is only set for the ones checked.
+  return kFALSE;
+}
+
+const TMatrixD& RooUnfold::GetWgtToy()
+{
+  // Inverse of the covariance matrix from toys, only recalculated when the toys are rerun.
+  if (_wgtToyVersion != _errMatVersion) {
+    InvertMatrix (_err_mat, _wgtToy, "covariance matrix from toys", _verbose);
+    _wgtToyVersion= _errMatVersion;
+  }
+  return _wgtToy;
+}
+
+void RooUnfold::RunToys (RooUnfold* unfold, Int_t first, Int_t last, ULong64_t seed, RooUnfoldWelford* acc) const
+{
+  // Unfold toys first..last-1 with unfold, reusing it, the smeared measurement,
+  // and (if the algorithm supports SetResponseToy) the smeared response matrix for each toy.
+  RooUnfoldRandom rnd;
+  TVectorD newmeas(_nm);
+  TMatrixD resbuf;
+  for (Int_t k= first; k<last; k++) {
+    rnd.SetStream (seed, k);
+    SmearToy (unfold, rnd, newmeas, &resbuf);
+    const TVectorD& x= unfold->Vreco();
+    if (x.GetNrows()==_nt) acc->Add (x);
+  }
+}
+
 Bool_t RooUnfold::UnfoldWithErrors (ErrorTreatment withError, bool getWeights)
 {
   if (!_unfolded) {
@@ -476,7 +574,7 @@ Double_t RooUnfold::Chi2(const TH1* hTrue,ErrorTreatment DoChi2)
     Returns warnings for small determinants of covariance matrices and if the condition is very large.
     If a matrix has to be inverted also removes rows/cols with all their elements equal to 0*/
 
-    if (!UnfoldWithErrors (DoChi2)) return -1.0;
+    if (!UnfoldWithErrors (DoChi2, DoChi2==kCovariance)) return -1.0;
 
     TVectorD res(_nt);
     for (Int_t i = 0 ; i < _nt; i++) {
@@ -488,12 +586,12 @@ Double_t RooUnfold::Chi2(const TH1* hTrue,ErrorTreatment DoChi2)
 
     Double_t chi2= 0.0;
     if (DoChi2==kCovariance || DoChi2==kCovToy) {
-        TMatrixD wgt= Wreco(DoChi2);
+        // use the cached weight matrix, rather than a copy from Wreco()
+        const TMatrixD& wgt= DoChi2==kCovariance ? _wgt : GetWgtToy();
         if (_fail) return -1.0;
-        TMatrixD resmat(1,_nt), chi2mat(1,1);
-        TMatrixDRow(resmat,0)= res;
-        ABAT (resmat, wgt, chi2mat);
-        chi2= chi2mat(0,0);
+        TVectorD wres= res;
+        wres *= wgt;
+        chi2= res*wres;
     } else {
         TVectorD ereco= ErecoV(DoChi2);
         if (_fail) return -1.0;
@@ -742,42 +840,83 @@ RooUnfold* RooUnfold::RunToy() const
   // Returns new RooUnfold object with smeared measurements and
   // (if IncludeSystematics) response matrix for use as a toy.
   // Use multiple toys to find spread of unfolding results.
+  return RunToy (*gRandom);
+}
+
+RooUnfold* RooUnfold::RunToy (TRandom& rnd) const
+{
+  // Returns new RooUnfold object for use as a toy, smeared using random number generator rnd.
   TString name= GetName();
   name += "_toy";
   RooUnfold* unfold = Clone(name);
+  TVectorD newmeas(_nm);
+  SmearToy (unfold, rnd, newmeas);
+  return unfold;
+}
+
+const TMatrixD& RooUnfold::GetCovL() const
+{
+  // _covL is a lower triangular matrix for which the covariance matrix, V = _covL * _covL^T.
+  if (!_covL) {
+    TDecompChol c(*_covMes);
+    c.Decompose();
+    TMatrixD U(c.GetU());
+    _covL= new TMatrixD (TMatrixD::kTransposed, U);
+    if (_verbose>=2) RooUnfoldResponse::PrintMatrix(*_covL,"decomposed measurement covariance matrix");
+  }
+  return *_covL;
+}
+
+void RooUnfold::PrepareToys() const
+{
+  // Fill caches used by SmearToy and by the set up of each toy's unfolding object, so that toys
+  // can be run in several threads. The response's caches are filled (and any pending updates
+  // after fills applied) here, as the toys' clones all share the response object.
+  Vmeasured();
+  Emeasured();
+  if (_haveCovMes) GetCovL();
+  _res->Vmeasured();
+  _res->Emeasured();
+  _res->Vfakes();
+  _res->Vtruth();
+  _res->Etruth();
+  _res->Mresponse();
+  _res->Eresponse();
+}
+
+void RooUnfold::SmearToy (RooUnfold* unfold, TRandom& rnd, TVectorD& newmeas, TMatrixD* resbuf) const
+{
+  // Sets unfold's measurements and (if IncludeSystematics) response matrix to smeared copies of ours.
+  // newmeas is work space. If resbuf is given and unfold supports it, the smeared response matrix
+  // is filled into resbuf, otherwise unfold gets its own smeared copy of the response object.
 
   // Make new smeared response matrix
-  if (_dosys) unfold->SetResponse (_res->RunToy(), kTRUE);
-  if (_dosys==2) return unfold;
+  if (_dosys) {
+    if (resbuf && unfold->SetResponseToy (resbuf))
+      _res->RunToy (rnd, *resbuf);
+    else
+      unfold->SetResponse (_res->RunToy(rnd), kTRUE);
+  }
+  if (_dosys==2) return;
 
   if (_haveCovMes) {
 
-    // _covL is a lower triangular matrix for which the covariance matrix, V = _covL * _covL^T.
-    if (!_covL) {
-      TDecompChol c(*_covMes);
-      c.Decompose();
-      TMatrixD U(c.GetU());
-      _covL= new TMatrixD (TMatrixD::kTransposed, U);
-      if (_verbose>=2) RooUnfoldResponse::PrintMatrix(*_covL,"decomposed measurement covariance matrix");
-    }
-    TVectorD newmeas(_nm);
-    for (Int_t i= 0; i<_nm; i++) newmeas[i]= gRandom->Gaus(0.0,1.0);
-    newmeas *= *_covL;
+    for (Int_t i= 0; i<_nm; i++) newmeas[i]= rnd.Gaus(0.0,1.0);
+    newmeas *= GetCovL();
     newmeas += Vmeasured();
     unfold->SetMeasured(newmeas,*_covMes);
 
   } else {
 
-    TVectorD newmeas= Vmeasured();
+    newmeas= Vmeasured();
     const TVectorD& err= Emeasured();
     for (Int_t i= 0; i<_nm; i++) {
       Double_t e= err[i];
-      if (e>0.0) newmeas[i] += gRandom->Gaus(0,e);
+      if (e>0.0) newmeas[i] += rnd.Gaus(0,e);
     }
     unfold->SetMeasured(newmeas,err);
 
   }
-  return unfold;
 }
 
 void RooUnfold::Print(Option_t* /*opt*/) const
@@ -933,7 +1072,7 @@ TMatrixD RooUnfold::Wreco(ErrorTreatment withError)
         Wreco_m=_wgt;
         break;
       case kCovToy:
-        InvertMatrix (_err_mat, Wreco_m, "covariance matrix from toys", _verbose);
+        Wreco_m= GetWgtToy();
         break;
       default:
         cerr<<"Error, unrecognised error method= "<<withError<<endl;
@@ -962,6 +1101,71 @@ TH1D* RooUnfold::HistNoOverflow (const TH1* h, Bool_t overflow)
   return hx;
 }
 
+static void ViewAxis (const TH1* h, Bool_t overflow, Int_t n, Double_t& lo, Double_t& width)
+{
+  // Axis of the 1D histogram with one bin per vector element of h, as made by HistNoOverflow and Resize
+  if (h->GetDimension()>=2) {
+    lo= 0.0;
+    width= 1.0/n;
+    return;
+  }
+  Int_t nx= h->GetNbinsX();
+  lo= h->GetXaxis()->GetXmin();
+  width= (h->GetXaxis()->GetXmax()-lo)/nx;
+  if (overflow) lo -= width;
+}
+
+TH1D* RooUnfold::HistNoOverflow (const TH1* h, Bool_t overflow, Int_t nb)
+{
+  // As HistNoOverflow(h,overflow) followed by Resize(hx,nb), but reads h directly (with RooUnfoldHistView),
+  // without intermediate copies. The vector elements of h go into bins 1..n, and any more bins up to nb are zeroed.
+  // Use this for a histogram the caller will modify, otherwise RooUnfoldHistView avoids the copy altogether.
+  RooUnfoldHistView hv (h, overflow);
+  Int_t n= hv.Size();
+  Double_t lo, width;
+  ViewAxis (h, overflow, n, lo, width);
+  TH1D* hx= new TH1D (h->GetName(), h->GetTitle(), nb, lo, lo+width*nb);
+  Bool_t s= h->GetSumw2N();
+  if (s) hx->Sumw2();
+  Double_t* c= hx->GetArray();
+  Double_t* w2= s ? hx->GetSumw2()->GetArray() : 0;
+  if (n>nb) n= nb;
+  for (Int_t i= 0; i < n; i++) {
+           c [i+1]= hv[i];
+    if (s) { Double_t e= hv.Error(i); w2[i+1]= e*e; }
+  }
+  return hx;
+}
+
+TH2D* RooUnfold::HistNoOverflow (const TH2* h, Bool_t overflow, Int_t nx, Int_t ny)
+{
+  // Response matrix h as a TH2D of nx x ny bins, with the under/overflows of 1D measured and truth
+  // in the histogram body if overflow. Extra bins are zeroed. See HistNoOverflow(h,overflow,nb).
+  RooUnfoldHistView hv (h, overflow);
+  Int_t mx= h->GetNbinsX(), my= h->GetNbinsY();
+  Double_t xlo= h->GetXaxis()->GetXmin(), xb= (h->GetXaxis()->GetXmax()-xlo)/mx;
+  Double_t ylo= h->GetYaxis()->GetXmin(), yb= (h->GetYaxis()->GetXmax()-ylo)/my;
+  if (overflow) {
+    mx += 2;  my += 2;
+    xlo -= xb; ylo -= yb;
+  }
+  TH2D* hx= new TH2D (h->GetName(), h->GetTitle(), nx, xlo, xlo+xb*nx, ny, ylo, ylo+yb*ny);
+  Bool_t s= h->GetSumw2N();
+  if (s) hx->Sumw2();
+  Double_t* c= hx->GetArray();
+  Double_t* w2= s ? hx->GetSumw2()->GetArray() : 0;
+  if (mx>nx) mx= nx;
+  if (my>ny) my= ny;
+  for (Int_t j= 0; j < my; j++) {
+    for (Int_t i= 0; i < mx; i++) {
+      Int_t bin= (i+1) + (nx+2)*(j+1);
+             c [bin]= hv(i,j);
+      if (s) { Double_t e= hv.Error(i,j); w2[bin]= e*e; }
+    }
+  }
+  return hx;
+}
+
 TH1* RooUnfold::Resize (TH1* h, Int_t nx, Int_t ny, Int_t nz)
 {
   // Resize a histogram with a different number of bins.
@@ -1066,25 +1270,83 @@ TH1* RooUnfold::Resize (TH1* h, Int_t nx, Int_t ny, Int_t nz)
 TMatrixD& RooUnfold::ABAT (const TMatrixD& a, const TMatrixD& b, TMatrixD& c)
 {
   // Fills C such that C = A * B * A^T. Note that C cannot be the same object as A.
-  TMatrixD d (b, TMatrixD::kMultTranspose, a);
-  c.Mult (a, d);
-  return c;
+  // B should be symmetric (eg. a covariance matrix), so that C is too and only its upper triangle is calculated.
+  TMatrixD ab (a, TMatrixD::kMult, b);
+  return ABTSym (ab, a, c);
 }
 
 TMatrixD& RooUnfold::ABAT (const TMatrixD& a, const TVectorD& b, TMatrixD& c)
 {
   // Fills C such that C = A * B * A^T, where B is a diagonal matrix specified by the vector.
   // Note that C cannot be the same object as A.
-  TMatrixD d (TMatrixD::kTransposed, a);
-  d.NormByColumn (b, "M");
-  c.Mult (a, d);
+  TMatrixD ab (a);
+  ab.NormByRow (b, "M");   // ab(i,k) = a(i,k)*b(k)
+  return ABTSym (ab, a, c);
+}
+
+TMatrixD& RooUnfold::ABTSym (const TMatrixD& a, const TMatrixD& b, TMatrixD& c)
+{
+  // Fills C such that C = A * B^T, where the result is known to be symmetric, eg. (A*D)*A^T for symmetric D.
+  // Only the upper triangle is calculated, in blocks of rows of A and B, and then copied to the lower.
+  // C cannot be the same object as A or B.
+  const Int_t nb= 32;
+  Int_t n= a.GetNrows(), m= a.GetNcols();
+  c.ResizeTo (n, n);
+  const Double_t* pa= a.GetMatrixArray();
+  const Double_t* pb= b.GetMatrixArray();
+  Double_t*       pc= c.GetMatrixArray();
+  for (Int_t i0= 0; i0<n; i0+=nb) {
+    Int_t i1= i0+nb < n ? i0+nb : n;
+    for (Int_t j0= i0; j0<n; j0+=nb) {
+      Int_t j1= j0+nb < n ? j0+nb : n;
+      for (Int_t i= i0; i<i1; i++) {
+        const Double_t* ai= pa + i*m;
+        for (Int_t j= (i>j0 ? i : j0); j<j1; j++) {
+          const Double_t* bj= pb + j*m;
+          Double_t sum= 0.0;
+          for (Int_t k= 0; k<m; k++) sum += ai[k]*bj[k];
+          pc[i*n+j]= sum;
+        }
+      }
+    }
+  }
+  for (Int_t i= 0; i<n; i++) {
+    for (Int_t j= 0; j<i; j++) pc[i*n+j]= pc[j*n+i];
+  }
   return c;
 }
 
 Int_t RooUnfold::InvertMatrix(const TMatrixD& mat, TMatrixD& inv, const char* name, Int_t verbose)
 {
-  // Invert a matrix using Single Value Decomposition: inv = mat^-1.
+  // Invert a matrix: inv = mat^-1.
+  // Covariance matrices are symmetric and usually positive-definite, so are inverted with a
+  // Cholesky decomposition if that succeeds and is well-conditioned. Otherwise (or if the matrix is
+  // not symmetric) Single Value Decomposition is used, which also gives a pseudo-inverse.
   // Can use InvertMatrix(mat,mat) to invert in-place.
+  Int_t ok= InvertCholesky (mat, inv, name, verbose);
+  if (ok<0) ok= InvertSVD (mat, inv, name, verbose);
+  if (ok==0) return ok;
+  if (verbose>=1) {
+    TMatrixD I (mat, TMatrixD::kMult, inv);
+    if (verbose>=3) RooUnfoldResponse::PrintMatrix(I,"V*V^-1");
+    Double_t m= 0.0;
+    for (Int_t i= 0; i<I.GetNrows(); i++) {
+      Double_t d= fabs(I(i,i)-1.0);
+      if (d>m) m= d;
+      for (Int_t j= 0; j<i; j++) {
+        d= fabs(I(i,j)); if (d>m) m= d;
+        d= fabs(I(j,i)); if (d>m) m= d;
+      }
+    }
+    cout << "Inverse " << name << " " << 100.0*m << "% maximum error" << endl;
+  }
+  return ok;
+}
+
+Int_t RooUnfold::InvertSVD (const TMatrixD& mat, TMatrixD& inv, const char* name, Int_t verbose)
+{
+  // Invert a matrix using Single Value Decomposition, giving the pseudo-inverse for singular matrices.
+  // Returns 0 if the inversion failed, 2 or 3 for a bad or poorly conditioned matrix, otherwise 1.
   Int_t ok= 1;
   TDecompSVD svd (mat);
   const Double_t cond_max= 1e17;
@@ -1115,21 +1377,44 @@ Int_t RooUnfold::InvertMatrix(const TMatrixD& mat, TMatrixD& inv, const char* na
 #else
   inv= svd.Invert();
 #endif
-  if (verbose>=1) {
-    TMatrixD I (mat, TMatrixD::kMult, inv);
-    if (verbose>=3) RooUnfoldResponse::PrintMatrix(I,"V*V^-1");
-    Double_t m= 0.0;
-    for (Int_t i= 0; i<I.GetNrows(); i++) {
-      Double_t d= fabs(I(i,i)-1.0);
-      if (d>m) m= d;
-      for (Int_t j= 0; j<i; j++) {
-        d= fabs(I(i,j)); if (d>m) m= d;
-        d= fabs(I(j,i)); if (d>m) m= d;
-      }
+  return ok;
+}
+
+Int_t RooUnfold::InvertCholesky (const TMatrixD& mat, TMatrixD& inv, const char* name, Int_t verbose)
+{
+  // Invert a symmetric positive-definite matrix with a Cholesky decomposition.
+  // Returns 1 on success, or -1 (with inv unchanged) if the matrix is not symmetric,
+  // not positive-definite, or too poorly conditioned, so that InvertMatrix uses SVD instead.
+  const Double_t cond_max= 1e12;   // Cholesky condition is a 1-norm estimate, so leave a margin
+  Int_t n= mat.GetNrows();
+  if (n==0 || n!=mat.GetNcols()) return -1;
+  Double_t amax= 0.0, dmax= 0.0;
+  for (Int_t i= 0; i<n; i++) {
+    if (fabs(mat(i,i))>amax) amax= fabs(mat(i,i));
+    for (Int_t j= 0; j<i; j++) {
+      Double_t d= fabs(mat(i,j)-mat(j,i));
+      if (d>dmax) dmax= d;
     }
-    cout << "Inverse " << name << " " << 100.0*m << "% maximum error" << endl;
   }
-  return ok;
+  if (dmax > 1e-12*amax) return -1;
+  TDecompChol chol (mat);
+  if (!chol.Decompose()) return -1;
+  Double_t cond= chol.Condition();
+  if (verbose >= 1) {
+    Double_t d1=0,d2=0;
+    chol.Det(d1,d2);
+    Double_t det= d1*TMath::Power(2.,d2);
+    cout << name << " Cholesky condition="<<cond<<", determinant="<<det;
+    if (d2!=0.0) cout <<" ("<<d1<<"*2^"<<d2<<")";
+    cout <<", tolerance="<<chol.GetTol()<<endl;
+  }
+  if (cond<0.0 || cond>cond_max) return -1;
+  Bool_t okinv= false;
+  TMatrixDSym sinv= chol.Invert(okinv);
+  if (!okinv) return -1;
+  inv.ResizeTo (n, n);
+  inv= sinv;
+  return 1;
 }
 
 void RooUnfold::Streamer (TBuffer &R__b)
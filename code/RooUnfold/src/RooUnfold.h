@@ -19,6 +19,10 @@
 
 class TH1;
 class TH1D;
+class TH2;
+class TH2D;
+class TRandom;
+class RooUnfoldWelford;
 
 class RooUnfold : public TNamed {
 
@@ -92,6 +96,10 @@ public:
   virtual Int_t      SystematicsIncluded() const;
   virtual Int_t      NToys() const;         // Number of toys
   virtual void       SetNToys (Int_t toys); // Set number of toys
+  virtual Int_t      NThreads() const;      // Number of threads used for toys
+  virtual void       SetNThreads (Int_t n); // Set number of threads used for toys (0 for one per core)
+  ULong64_t          ToySeed() const;       // Seed for toy random number streams
+  void               SetToySeed (ULong64_t seed); // Set seed for toy random number streams (0 to take one from gRandom)
   virtual Int_t      Overflow() const;
   virtual void       PrintTable (std::ostream& o, const TH1* hTrue= 0, ErrorTreatment withError=kDefault);
   virtual void       SetRegParm (Double_t parm);
@@ -102,6 +110,10 @@ public:
   Double_t GetStepSizeParm() const;
   Double_t GetDefaultParm() const;
   RooUnfold* RunToy() const;
+  RooUnfold* RunToy (TRandom& rnd) const;
+  void SmearToy (RooUnfold* unfold, TRandom& rnd, TVectorD& newmeas, TMatrixD* resbuf= 0) const; // Reuse unfold for a toy
+  void PrepareToys() const; // Fill the caches SmearToy uses, so toys can then be run in several threads
+  virtual Bool_t SetResponseToy (const TMatrixD* mres); // Unfold with response matrix mres (not owned) instead of the response object's
   void Print(Option_t* opt="") const;
 
   static void PrintTable (std::ostream& o, const TH1* hTrainTrue, const TH1* hTrain,
@@ -112,6 +124,10 @@ public:
   static void PrintTable (std::ostream& o, const TVectorD& vTrainTrue, const TVectorD& vTrain,
                           const TVectorD& vMeas, const TVectorD& vReco, Int_t nm, Int_t nt);
 
+  static TMatrixD& ABAT (const TMatrixD& a, const TMatrixD& b, TMatrixD& c);  // C = A*B*A^T, B symmetric
+  static TMatrixD& ABAT (const TMatrixD& a, const TVectorD& b, TMatrixD& c);  // C = A*diag(B)*A^T
+  static TMatrixD& ABTSym (const TMatrixD& a, const TMatrixD& b, TMatrixD& c); // C = A*B^T, known to be symmetric
+
 protected:
   void Assign (const RooUnfold& rhs); // implementation of assignment operator
   virtual void SetNameTitleDefault();
@@ -125,15 +141,27 @@ protected:
 
   static TMatrixD CutZeros     (const TMatrixD& ereco);
   static TH1D*    HistNoOverflow (const TH1* h, Bool_t overflow);
-  static TMatrixD& ABAT (const TMatrixD& a, const TMatrixD& b, TMatrixD& c);
-  static TMatrixD& ABAT (const TMatrixD& a, const TVectorD& b, TMatrixD& c);
+  static TH1D*    HistNoOverflow (const TH1* h, Bool_t overflow, Int_t nb);  // copy with nb bins, without intermediate copies
+  static TH2D*    HistNoOverflow (const TH2* h, Bool_t overflow, Int_t nx, Int_t ny);
   static TH1*     Resize (TH1* h, Int_t nx, Int_t ny=-1, Int_t nz=-1);
   static Int_t    InvertMatrix (const TMatrixD& mat, TMatrixD& inv, const char* name="matrix", Int_t verbose=1);
+  static Int_t    InvertCholesky (const TMatrixD& mat, TMatrixD& inv, const char* name="matrix", Int_t verbose=1);
+  static Int_t    InvertSVD (const TMatrixD& mat, TMatrixD& inv, const char* name="matrix", Int_t verbose=1);
+  const TMatrixD& ResponseMatrix() const;
+  const TMatrixD& GetWgtToy();
+  void UseResponseToy (const TMatrixD* mres);
+  Int_t ToyThreads (Int_t njobs, Bool_t copies= kTRUE) const; // Number of threads to share njobs toys or scan points between
+  virtual Bool_t ToysInThreads() const; // Copies of this object can unfold in separate threads
+
+  friend class RooUnfoldErrors;  // use ToyThreads
+  friend class RooUnfoldParms;
 
 private:
   void Init();
   void Destroy();
   void CopyData (const RooUnfold& rhs);
+  const TMatrixD& GetCovL() const;
+  void RunToys (RooUnfold* unfold, Int_t first, Int_t last, ULong64_t seed, RooUnfoldWelford* acc) const;
 
 protected:
   // instance variables
@@ -168,6 +196,12 @@ protected:
   mutable TMatrixD* _covMes;       // Measurement covariance matrix
   mutable TMatrixD* _covL; //! Cached lower triangular matrix for which _covMes = _covL * _covL^T.
   ErrorTreatment _withError; // type of error last calulcated
+  Int_t    _nthreads;      //! Number of threads used for toys
+  const TMatrixD* _resToy; //! Response matrix used instead of _res->Mresponse(), eg. for toys (not owned)
+  Int_t    _errMatVersion; //! Incremented each time _err_mat is calculated
+  Int_t    _wgtToyVersion; //! Value of _errMatVersion for which _wgtToy was calculated
+  TMatrixD _wgtToy;        //! Inverse of _err_mat
+  ULong64_t _toyseed;      //! Seed for toy random number streams
 
 public:
 
@@ -297,6 +331,52 @@ void  RooUnfold::SetNToys (Int_t toys)
   _NToys= toys;
 }
 
+inline
+const TMatrixD& RooUnfold::ResponseMatrix() const
+{
+  // Response matrix to unfold with: the one set by SetResponseToy, if any, otherwise the response object's
+  return _resToy ? *_resToy : _res->Mresponse();
+}
+
+inline
+void RooUnfold::UseResponseToy (const TMatrixD* mres)
+{
+  // Use response matrix mres for the next unfolding. For SetResponseToy implementations.
+  _resToy= mres;
+  _unfolded= _haveCov= _haveWgt= _haveErrors= _have_err_mat= _fail= kFALSE;
+}
+
+inline
+Int_t RooUnfold::NThreads()  const
+{
+  // Get number of threads used in kCovToy error calculation.
+  return _nthreads;
+}
+
+inline
+void  RooUnfold::SetNThreads (Int_t n)
+{
+  // Set number of threads used in kCovToy error calculation. 0 uses one thread per core.
+  // Algorithms that are not safe to run in threads (see ToysInThreads) always use one.
+  _nthreads= n;
+}
+
+inline
+ULong64_t RooUnfold::ToySeed() const
+{
+  // Get seed for toy random number streams.
+  return _toyseed;
+}
+
+inline
+void  RooUnfold::SetToySeed (ULong64_t seed)
+{
+  // Set seed for toy random number streams. Toy k uses stream (seed,k), so results only depend on
+  // the number of threads through rounding. If 0, a new seed is taken from gRandom for each set of toys.
+  if (seed!=_toyseed) _have_err_mat= kFALSE;
+  _toyseed= seed;
+}
+
 inline
 void  RooUnfold::SetRegParm (Double_t)
 {
@@ -0,0 +1,271 @@
+//=====================================================================-*-C++-*-
+// File and Version Information:
+//      $Id$
+//
+// Description:
+//      Unfold several independent distributions together, with a block-diagonal response.
+//
+//==============================================================================
+
+//____________________________________________________________
+/* BEGIN_HTML
+<p>Unfolds several independent distributions, each with its own response, in a
+single call. The setup is shared by all the blocks, so this only helps when all the
+distributions are available together. It is not used by the analysis macros:
+dagostini.C unfolds each rapidity bin as its directory is read, with a response
+made from the fit in that bin, and keeps a RooUnfoldSession for each bin.</p>
+<p>Each distribution is added as a block with AddBlock(). Setup() packs the
+responses into one block-diagonal RooUnfoldResponse, with the measured and truth
+bins of each block following those of the previous one, and creates a single
+unfolding object for it. Unfold() then unfolds all the blocks together, and
+Vreco(), Ereco() and Hreco() return the result of each block in its own binning.
+New measured distributions can be given with SetMeasured() and unfolded again
+without repeating the setup.</p>
+<p>RooUnfoldBayes finds the blocks of the combined response and keeps its
+iterations and error propagation inside them, so each block gives the same
+result as unfolding it on its own, and the covariance between blocks is zero.
+The exceptions are that the tolerance (RooUnfoldBayes::SetTolerance) applies
+to the chi2 of change summed over all blocks, so all blocks stop after the same
+number of iterations, and that fakes in any block go into one shared fakes bin,
+which couples the blocks.
+RooUnfoldBinByBin and RooUnfoldInvert are also independent for each block.
+Other algorithms regularise the combined distribution as a whole (eg. the
+curvature in RooUnfoldSvd spans the block boundaries), so are not accepted.</p>
+END_HTML */
+
+/////////////////////////////////////////////////////////////
+
+#include "RooUnfoldBatch.h"
+
+#include <iostream>
+#include <cmath>
+
+#include "TH1.h"
+#include "TH2.h"
+
+#include "RooUnfoldResponse.h"
+#include "RooUnfoldHistView.h"
+
+using std::cerr;
+using std::endl;
+using std::sqrt;
+using std::fabs;
+
+ClassImp (RooUnfoldBatch);
+
+RooUnfoldBatch::RooUnfoldBatch (const char* name, const char* title)
+  : TNamed (name, title ? title : "unfolding batch"),
+    _res(0), _unf(0), _withError(RooUnfold::kCovariance), _unfolded(false)
+{
+  // Constructor with name and title. Blocks are added with AddBlock().
+  _offM.assign (1, 0);
+  _offT.assign (1, 0);
+}
+
+RooUnfoldBatch::~RooUnfoldBatch()
+{
+  Clean();
+}
+
+void RooUnfoldBatch::Clean()
+{
+  // Delete the combined response and unfolding object, eg. after adding a block.
+  delete _unf; _unf= 0;
+  delete _res; _res= 0;
+  _unfolded= false;
+}
+
+Bool_t RooUnfoldBatch::CheckBlock (Int_t block) const
+{
+  if (block >= 0 && block < GetNblocks()) return true;
+  cerr << "Error: block " << block << " out of range (" << GetNblocks() << " blocks)" << endl;
+  return false;
+}
+
+void RooUnfoldBatch::MeasuredVector (const TH1* meas, Int_t nm, Bool_t overflow, TVectorD& v, TMatrixD& cov) const
+{
+  // Measured histogram contents, and a diagonal covariance matrix from its bin errors.
+  RooUnfoldHistView h (meas, overflow);
+  v.ResizeTo (nm);
+  cov.ResizeTo (nm, nm);
+  cov.Zero();
+  for (Int_t i= 0; i<nm && i<h.Size(); i++) {
+    v[i]= h[i];
+    Double_t e= h.Error(i);
+    cov(i,i)= e*e;
+  }
+}
+
+Int_t RooUnfoldBatch::AddBlock (const RooUnfoldResponse* res, const TH1* meas, const char* name)
+{
+  // Add a block with its response and measured histogram, using the histogram's bin errors.
+  // The histogram is copied, so need not be kept. Returns the block number.
+  Int_t nm= res->GetNbinsMeasured() + (res->UseOverflowStatus() ? 2 : 0);
+  TVectorD v;
+  TMatrixD cov;
+  MeasuredVector (meas, nm, res->UseOverflowStatus(), v, cov);
+  return AddBlock (res, v, cov, name);
+}
+
+Int_t RooUnfoldBatch::AddBlock (const RooUnfoldResponse* res, const TVectorD& meas, const TMatrixD& cov, const char* name)
+{
+  // Add a block with its response, measured distribution and covariance matrix.
+  // The response must be kept until the batch is deleted. Returns the block number, or -1 on error.
+  Int_t nm= res->GetNbinsMeasured() + (res->UseOverflowStatus() ? 2 : 0);
+  Int_t nt= res->GetNbinsTruth()    + (res->UseOverflowStatus() ? 2 : 0);
+  if (meas.GetNrows() != nm || cov.GetNrows() != nm || cov.GetNcols() != nm) {
+    cerr << "Error: measured distribution with " << meas.GetNrows() << " bins and " << cov.GetNrows() << "x" << cov.GetNcols()
+         << " covariance matrix for response with " << nm << " measured bins" << endl;
+    return -1;
+  }
+  Clean();
+  Int_t block= GetNblocks();
+  _blkRes.push_back (res);
+  _blkName.push_back (name ? TString(name) : TString::Format ("block%d", block));
+  _blkMes.push_back (meas);
+  _blkCov.push_back (cov);
+  _offM.push_back (_offM.back() + nm);
+  _offT.push_back (_offT.back() + nt);
+  return block;
+}
+
+void RooUnfoldBatch::SetMeasured (Int_t block, const TH1* meas)
+{
+  // Replace the block's measured distribution with a histogram. The combined response is reused.
+  if (!CheckBlock (block)) return;
+  const RooUnfoldResponse* res= _blkRes[block];
+  MeasuredVector (meas, _offM[block+1]-_offM[block], res->UseOverflowStatus(), _blkMes[block], _blkCov[block]);
+  _unfolded= false;
+}
+
+void RooUnfoldBatch::SetMeasured (Int_t block, const TVectorD& meas, const TMatrixD& cov)
+{
+  // Replace the block's measured distribution and covariance matrix. The combined response is reused.
+  if (!CheckBlock (block)) return;
+  Int_t nm= _offM[block+1]-_offM[block];
+  if (meas.GetNrows() != nm || cov.GetNrows() != nm || cov.GetNcols() != nm) {
+    cerr << "Error: measured distribution for block " << block << " should have " << nm << " bins" << endl;
+    return;
+  }
+  _blkMes[block]= meas;
+  _blkCov[block]= cov;
+  _unfolded= false;
+}
+
+Int_t RooUnfoldBatch::FindBlock (const char* name) const
+{
+  // Block number with the given name, or -1 if not found.
+  for (Int_t b= 0; b<GetNblocks(); b++) {
+    if (_blkName[b] == name) return b;
+  }
+  return -1;
+}
+
+RooUnfold* RooUnfoldBatch::Setup (RooUnfold::Algorithm alg, Double_t regparm)
+{
+  // Pack the block responses into the combined block-diagonal response, and create its unfolding object,
+  // which is returned so options can be set before Unfold().
+  Clean();
+  if (GetNblocks() == 0) {
+    cerr << "Error: no blocks to unfold" << endl;
+    return 0;
+  }
+  if (alg != RooUnfold::kBayes && alg != RooUnfold::kBinByBin && alg != RooUnfold::kInvert && alg != RooUnfold::kNone) {
+    cerr << "Error: unfolding algorithm " << alg << " does not keep blocks independent" << endl;
+    return 0;
+  }
+  Int_t nm= _offM.back(), nt= _offT.back();
+  Bool_t oldstat= TH1::AddDirectoryStatus();
+  TH1::AddDirectory (kFALSE);
+  TH1D* hmes= new TH1D ("measured", "Measured", nm, 0.0, nm);
+  TH1D* htru= new TH1D ("truth",    "Truth",    nt, 0.0, nt);
+  TH2D* hres= new TH2D ("response", "Response", nm, 0.0, nm, nt, 0.0, nt);
+  TH1::AddDirectory (oldstat);
+  hres->Sumw2();
+  for (Int_t b= 0; b<GetNblocks(); b++) {
+    const RooUnfoldResponse* res= _blkRes[b];
+    Bool_t overflow= res->UseOverflowStatus();
+    if (alg == RooUnfold::kBayes && res->FakeEntries())
+      cerr << "Warning: fakes in block " << _blkName[b] << " share the fakes bin of all blocks" << endl;
+    RooUnfoldHistView m (res->Hmeasured(), overflow), t (res->Htruth(), overflow), r (res->Hresponse(), overflow);
+    Int_t om= _offM[b], ot= _offT[b], nmb= _offM[b+1]-om, ntb= _offT[b+1]-ot;
+    for (Int_t i= 0; i<nmb; i++) {
+      hmes->SetBinContent (om+i+1, m[i]);
+      hmes->SetBinError   (om+i+1, m.Error(i));
+    }
+    for (Int_t j= 0; j<ntb; j++) {
+      htru->SetBinContent (ot+j+1, t[j]);
+      htru->SetBinError   (ot+j+1, t.Error(j));
+    }
+    for (Int_t j= 0; j<ntb; j++) {
+      for (Int_t i= 0; i<nmb; i++) {
+        Double_t x= r(i,j);
+        if (x == 0.0) continue;
+        hres->SetBinContent (om+i+1, ot+j+1, x);
+        hres->SetBinError   (om+i+1, ot+j+1, r.Error(i,j));
+      }
+    }
+  }
+  _res= new RooUnfoldResponse (hmes, htru, hres, GetName(), GetTitle());
+  delete hmes;
+  delete htru;
+  delete hres;
+  _unf= RooUnfold::New (alg, _res, _res->Hmeasured(), regparm, GetName(), GetTitle());
+  return _unf;
+}
+
+Bool_t RooUnfoldBatch::Unfold()
+{
+  // Unfold the measured distributions of all blocks together. Calls Setup() for RooUnfoldBayes if not already done.
+  if (!_unf && !Setup()) return false;
+  Int_t nm= _offM.back();
+  TVectorD meas(nm);
+  TMatrixD cov(nm,nm);
+  for (Int_t b= 0; b<GetNblocks(); b++) {
+    meas.SetSub (_offM[b], _blkMes[b]);
+    cov.SetSub  (_offM[b], _offM[b], _blkCov[b]);
+  }
+  _unf->SetMeasured (meas, cov);
+  const TVectorD& r= _unf->Vreco();
+  _rec.ResizeTo (r);
+  _rec= r;
+  TMatrixD c= _unf->Ereco (_withError);
+  _cov.ResizeTo (c);
+  _cov= c;
+  _unfolded= true;
+  return true;
+}
+
+TVectorD RooUnfoldBatch::Vreco (Int_t block) const
+{
+  // Unfolded distribution of the block, from the last Unfold().
+  if (!CheckBlock (block) || !_unfolded) return TVectorD();
+  return _rec.GetSub (_offT[block], _offT[block+1]-1);
+}
+
+TMatrixD RooUnfoldBatch::Ereco (Int_t block) const
+{
+  // Covariance matrix of the block's unfolded distribution, using the error treatment set by SetErrorTreatment().
+  if (!CheckBlock (block) || !_unfolded) return TMatrixD();
+  return _cov.GetSub (_offT[block], _offT[block+1]-1, _offT[block], _offT[block+1]-1);
+}
+
+TH1* RooUnfoldBatch::Hreco (Int_t block) const
+{
+  // Unfolded distribution of the block as a histogram, with the binning of its response's truth distribution.
+  // Errors are from the diagonal of Ereco(block), unless SetErrorTreatment(kNoError).
+  if (!CheckBlock (block) || !_unfolded) return 0;
+  const RooUnfoldResponse* res= _blkRes[block];
+  Bool_t overflow= res->UseOverflowStatus();
+  TH1* reco= (TH1*) res->Htruth()->Clone (TString::Format ("%s_%s", GetName(), _blkName[block].Data()));
+  reco->Reset();
+  reco->SetTitle (GetTitle());
+  Int_t ot= _offT[block], ntb= _offT[block+1]-ot;
+  for (Int_t i= 0; i<ntb; i++) {
+    Int_t j= RooUnfoldResponse::GetBin (reco, i, overflow);
+    reco->SetBinContent (j, _rec[ot+i]);
+    if (_withError != RooUnfold::kNoError)
+      reco->SetBinError (j, sqrt (fabs (_cov(ot+i,ot+i))));
+  }
+  return reco;
+}
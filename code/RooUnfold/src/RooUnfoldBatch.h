@@ -0,0 +1,139 @@
+//=====================================================================-*-C++-*-
+// File and Version Information:
+//      $Id$
+//
+// Description:
+//      Unfold several independent distributions together, with a block-diagonal response.
+//
+//==============================================================================
+
+#ifndef ROOUNFOLDBATCH_HH
+#define ROOUNFOLDBATCH_HH
+
+#include <vector>
+
+#include "TNamed.h"
+#include "TString.h"
+#include "TVectorD.h"
+#include "TMatrixD.h"
+#include "RooUnfold.h"
+
+class TH1;
+class RooUnfoldResponse;
+
+class RooUnfoldBatch : public TNamed {
+
+public:
+
+  RooUnfoldBatch(); // default constructor
+  RooUnfoldBatch (const char* name, const char* title= 0);
+  virtual ~RooUnfoldBatch(); // destructor
+
+  Int_t AddBlock (const RooUnfoldResponse* res, const TH1* meas, const char* name= 0);
+  Int_t AddBlock (const RooUnfoldResponse* res, const TVectorD& meas, const TMatrixD& cov, const char* name= 0);
+  void  SetMeasured (Int_t block, const TH1* meas);
+  void  SetMeasured (Int_t block, const TVectorD& meas, const TMatrixD& cov);
+
+  RooUnfold* Setup (RooUnfold::Algorithm alg= RooUnfold::kBayes, Double_t regparm= -1e30);
+  Bool_t     Unfold();
+
+  Int_t       GetNblocks() const;
+  Int_t       FindBlock (const char* name) const;
+  const char* GetBlockName (Int_t block) const;
+  const RooUnfoldResponse* BlockResponse (Int_t block) const;
+
+  TVectorD Vreco (Int_t block) const;
+  TMatrixD Ereco (Int_t block) const;
+  TH1*     Hreco (Int_t block) const;
+
+  void SetErrorTreatment (RooUnfold::ErrorTreatment withError);
+  RooUnfold::ErrorTreatment GetErrorTreatment() const;
+  RooUnfold* Impl();
+  const RooUnfoldResponse* response() const;
+
+private:
+  RooUnfoldBatch (const RooUnfoldBatch& rhs); // not implemented
+  RooUnfoldBatch& operator= (const RooUnfoldBatch& rhs); // not implemented
+  void Clean();
+  Bool_t CheckBlock (Int_t block) const;
+  void MeasuredVector (const TH1* meas, Int_t nm, Bool_t overflow, TVectorD& v, TMatrixD& cov) const;
+
+  std::vector<const RooUnfoldResponse*> _blkRes; // response of each block (not owned)
+  std::vector<TString>  _blkName;  // name of each block
+  std::vector<TVectorD> _blkMes;   // measured distribution of each block
+  std::vector<TMatrixD> _blkCov;   // measured covariance matrix of each block
+  std::vector<Int_t> _offM, _offT; // first measured and truth bin of each block in the combined vectors, and the totals
+  RooUnfoldResponse* _res;         // combined block-diagonal response (owned)
+  RooUnfold* _unf;                 // unfolding object for the combined response (owned)
+  RooUnfold::ErrorTreatment _withError; // Error treatment for returned covariances
+  Bool_t   _unfolded;              // _rec and _cov are up to date
+  TVectorD _rec;                   // combined unfolded result
+  TMatrixD _cov;                   // combined unfolded covariance matrix
+
+public:
+
+  ClassDef (RooUnfoldBatch, 0) // Unfold independent distributions with a block-diagonal response
+};
+
+// Inline method definitions
+
+inline
+RooUnfoldBatch::RooUnfoldBatch()
+  : TNamed(), _res(0), _unf(0), _withError(RooUnfold::kCovariance), _unfolded(false)
+{
+  // Default constructor.
+  _offM.assign (1, 0);
+  _offT.assign (1, 0);
+}
+
+inline
+Int_t RooUnfoldBatch::GetNblocks() const
+{
+  // Number of blocks added.
+  return _blkRes.size();
+}
+
+inline
+const char* RooUnfoldBatch::GetBlockName (Int_t block) const
+{
+  // Name given to the block.
+  return CheckBlock (block) ? _blkName[block].Data() : 0;
+}
+
+inline
+const RooUnfoldResponse* RooUnfoldBatch::BlockResponse (Int_t block) const
+{
+  // Response matrix object of the block.
+  return CheckBlock (block) ? _blkRes[block] : 0;
+}
+
+inline
+void RooUnfoldBatch::SetErrorTreatment (RooUnfold::ErrorTreatment withError)
+{
+  // Set error treatment used for the returned covariance matrices (default kCovariance).
+  _withError= withError;
+  _unfolded= false;
+}
+
+inline
+RooUnfold::ErrorTreatment RooUnfoldBatch::GetErrorTreatment() const
+{
+  // Error treatment used for the returned covariance matrices.
+  return _withError;
+}
+
+inline
+RooUnfold* RooUnfoldBatch::Impl()
+{
+  // Unfolding object for the combined response, eg. to set options. Zero before Setup().
+  return _unf;
+}
+
+inline
+const RooUnfoldResponse* RooUnfoldBatch::response() const
+{
+  // Combined block-diagonal response matrix object. Zero before Setup().
+  return _res;
+}
+
+#endif
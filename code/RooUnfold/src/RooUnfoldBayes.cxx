@@ -15,6 +15,17 @@
 <p>Works for 2 and 3 dimensional distributions
 <p>Returned errors can be either as a diagonal matrix or as a full matrix of covariances
 <p>Regularisation parameter sets the number of iterations used in the unfolding (default=4)
+<p>With SetTolerance(tol), iterations stop as soon as the chi2 of change falls below tol, and the regularisation parameter is the maximum number of iterations.
+The chi2 and number of events after each iteration are kept in Chi2History() and NtrueHistory().
+<p>After KeepIterations(), an unfolding also keeps its result and error propagation matrices after each iteration.
+RestoreIteration(n) then gives the result and errors for any n up to the number of iterations done,
+so a scan over the number of iterations (as in RooUnfoldParms) only needs one unfolding.
+<p>With SetFloatStorage(), the band of the normalised response, and the terms kept for each iteration
+(the response error propagation factors and, with KeepIterations(), the unfolding and error propagation matrices),
+are stored in single precision, halving the memory they take. The unfolding and error propagation matrices of the
+current iteration, the full response used during the setup, and the covariance matrices stay in double precision.
+All sums are still done in double precision, so results and errors differ from the default by about the
+single-precision rounding (10<sup>-6</sup> relative).
 <p>Is able to account for bin migration and smearing
 <p>Can unfold if test and measured distributions have different binning.
 <p>Returns covariance matrices with conditions approximately that of the machine precision. This occasionally leads to very large chi squared values
@@ -35,6 +46,7 @@ END_HTML */
 #include "TNamed.h"
 #include "TH1.h"
 #include "TH2.h"
+#include "TMatrixF.h"
 
 #include "RooUnfoldResponse.h"
 
@@ -48,6 +60,155 @@ using std::right;
 
 ClassImp (RooUnfoldBayes);
 
+//-------------------------------------------------------------------------
+// Single-precision storage, see SetFloatStorage. The matrices are only stored as floats:
+// they are converted back to double precision, or promoted element by element, for all arithmetic.
+
+static void ToFloat (const TMatrixD& d, TMatrixF& f)
+{
+  f.ResizeTo (d.GetNrows(), d.GetNcols());
+  const Double_t* pd= d.GetMatrixArray();
+  Float_t*        pf= f.GetMatrixArray();
+  for (Int_t i= 0, n= d.GetNoElements(); i < n; i++) pf[i]= pd[i];
+}
+
+static void ToFloat (const TVectorD& d, TVectorF& f)
+{
+  f.ResizeTo (d.GetNrows());
+  const Double_t* pd= d.GetMatrixArray();
+  Float_t*        pf= f.GetMatrixArray();
+  for (Int_t i= 0, n= d.GetNrows(); i < n; i++) pf[i]= pd[i];
+}
+
+static void ToDouble (const TMatrixF& f, TMatrixD& d)
+{
+  d.ResizeTo (f.GetNrows(), f.GetNcols());
+  const Float_t* pf= f.GetMatrixArray();
+  Double_t*      pd= d.GetMatrixArray();
+  for (Int_t i= 0, n= f.GetNoElements(); i < n; i++) pd[i]= pf[i];
+}
+
+static void ToDouble (const TVectorF& f, TVectorD& d)
+{
+  d.ResizeTo (f.GetNrows());
+  const Float_t* pf= f.GetMatrixArray();
+  Double_t*      pd= d.GetMatrixArray();
+  for (Int_t i= 0, n= f.GetNrows(); i < n; i++) pd[i]= pf[i];
+}
+
+template <class D, class F>
+static void Keep (std::vector<D>& d, std::vector<F>& f, Bool_t single, const D& m)
+{
+  // Append m to d or, in single precision, to f
+  if (!single) {
+    d.push_back (m);
+    return;
+  }
+  f.push_back (F());
+  if (m.GetNoElements() > 0) ToFloat (m, f.back());
+}
+
+template <class D, class F>
+static const D& Kept (const std::vector<D>& d, const std::vector<F>& f, size_t k, D& work)
+{
+  // Element k of d or, if kept in single precision, of f, converted into work
+  if (f.empty()) return d[k];
+  ToDouble (f[k], work);
+  return work;
+}
+
+//-------------------------------------------------------------------------
+// Packed matrices: the unfolding matrix is stored as the band [lo[i],hi[i]) of each row i, and the
+// error propagation matrix as the block of effects of each row, both starting at beg[i] in one array.
+
+static TMatrixD& Unpack (const Double_t* p, const std::vector<Int_t>& lo, const std::vector<Int_t>& hi, const std::vector<Int_t>& beg,
+                         Int_t r0, Int_t nr, Int_t c0, Int_t nc, TMatrixD& m)
+{
+  // Rows r0..r0+nr-1 and columns c0..c0+nc-1 of the packed matrix p, as a full matrix
+  m.ResizeTo (nr, nc);
+  m.Zero();
+  for (Int_t i = r0 ; i < r0+nr ; i++) {
+    const Int_t jlo= lo[i] > c0 ? lo[i] : c0, jhi= hi[i] < c0+nc ? hi[i] : c0+nc;
+    for (Int_t j = jlo ; j < jhi ; j++) m(i-r0,j-c0)= p[beg[i]+j-lo[i]];
+  }
+  return m;
+}
+
+#ifdef OLDMULT
+static void Pack (const TMatrixD& m, const std::vector<Int_t>& lo, const std::vector<Int_t>& hi, const std::vector<Int_t>& beg, Double_t* p)
+{
+  // Store the full matrix m in packed form, dropping elements outside the range of each row
+  for (Int_t i = 0 ; i < m.GetNrows() ; i++)
+    for (Int_t j = lo[i] ; j < hi[i] ; j++) p[beg[i]+j-lo[i]]= m(i,j);
+}
+#endif
+
+template <class T>
+static void FoldPrior (const T* pPE, const Double_t* pPEfake, const Double_t* pP0C,
+                       const std::vector<Int_t>& iLo, const std::vector<Int_t>& iHi, const std::vector<Int_t>& iBeg,
+                       Int_t ne, Int_t ifake, Double_t* pUinv)
+{
+  // 1/(folded prior), from the band of each row of P(E_j|C_i)
+  for (Int_t j = 0 ; j < ne ; j++) {
+    const T* PEj= pPE + iBeg[j];
+    const Int_t lo= iLo[j];
+    Double_t Uj = 0.0;
+    for (Int_t i = lo ; i < iHi[j] ; i++)
+      Uj += PEj[i-lo] * pP0C[i];
+    if (ifake>=0) Uj += pPEfake[j] * pP0C[ifake];
+    pUinv[j] = Uj > 0.0 ? 1.0/Uj : 0.0;
+  }
+}
+
+template <class T>
+static Double_t FillUnfoldingMatrix (const T* pEffT, const Double_t* pUinv, const Double_t* pP0C, const Double_t* pnE,
+                                     const std::vector<Int_t>& jLo, const std::vector<Int_t>& jHi, const std::vector<Int_t>& jBeg,
+                                     Int_t nc, Double_t* pM, Double_t* pnbarC)
+{
+  // Unfolding matrix M, filled row by row inside the band together with the new estimate. Returns the estimated total.
+  // M is packed like the transposed response, with the same band.
+  Double_t nbartrue = 0.0;
+  for (Int_t i = 0 ; i < nc ; i++) {
+    const T*       effi= pEffT + jBeg[i];
+    const Int_t    lo=   jLo[i];
+    Double_t*      Mi=   pM    + jBeg[i];
+    const Double_t P0Ci= pP0C[i];
+    Double_t nbarC = 0.0;
+    for (Int_t j = lo ; j < jHi[i] ; j++) {
+      Double_t Mij = pUinv[j] * effi[j-lo] * P0Ci;
+      Mi[j-lo] = Mij;
+      nbarC += Mij * pnE[j];
+    }
+    pnbarC[i] = nbarC;
+    nbartrue += nbarC;  // best estimate of true number of events
+  }
+  return nbartrue;
+}
+
+template <class T>
+static void MinusBandProduct (const Double_t* pM, const Double_t* w, const T* pPE, const Double_t* pPEfake,
+                              const std::vector<Int_t>& jLo, const std::vector<Int_t>& jHi, const std::vector<Int_t>& jBeg,
+                              const std::vector<Int_t>& iLo, const std::vector<Int_t>& iHi, const std::vector<Int_t>& iBeg,
+                              Int_t nc, Int_t ifake, TMatrixD& t)
+{
+  // t = - M diag(w) P(E|C), summing only over the bands of M and P(E|C) (and the fakes column of P(E|C))
+  t.ResizeTo (nc, nc);
+  t.Zero();
+  Double_t* pt= t.GetMatrixArray();
+  for (Int_t i = 0 ; i < nc ; i++) {
+    const Double_t* Mi= pM + jBeg[i];
+    Double_t*       ti= pt + i*nc;
+    for (Int_t j = jLo[i] ; j < jHi[i] ; j++) {
+      const Double_t a= Mi[j-jLo[i]] * w[j];
+      if (a==0.0) continue;
+      const T* PEj= pPE + iBeg[j];
+      const Int_t lo= iLo[j];
+      for (Int_t k = lo ; k < iHi[j] ; k++) ti[k] -= a * PEj[k-lo];
+      if (ifake>=0) ti[ifake] -= a * pPEfake[j];
+    }
+  }
+}
+
 RooUnfoldBayes::RooUnfoldBayes (const RooUnfoldBayes& rhs)
   : RooUnfold (rhs)
 {
@@ -76,7 +237,12 @@ RooUnfoldBayes* RooUnfoldBayes::Clone (const char* newname) const
 void RooUnfoldBayes::Init()
 {
   _nc= _ne= 0;
+  _resVersion= -1;
   _nbartrue= _N0C= 0.0;
+  _tolerance= 0.0;
+  _float= false;
+  _keepIter= false;
+  _nsys= 0;
   GetSettings();
 }
 
@@ -96,15 +262,33 @@ void RooUnfoldBayes::CopyData (const RooUnfoldBayes& rhs)
 {
   _niter=    rhs._niter;
   _smoothit= rhs._smoothit;
+  _tolerance= rhs._tolerance;
+  _float= rhs._float;
+}
+
+void RooUnfoldBayes::SetResponse (const RooUnfoldResponse* res)
+{
+  // Set response matrix for unfolding. Response-derived quantities are recalculated on the next unfold.
+  _nc= _ne= 0;
+  RooUnfold::SetResponse (res);
+}
+
+Bool_t RooUnfoldBayes::SetResponseToy (const TMatrixD* mres)
+{
+  // Unfold with response matrix mres, eg. for a toy. Response-derived quantities are recalculated on the next unfold.
+  _nc= _ne= 0;
+  UseResponseToy (mres);
+  return kTRUE;
 }
 
 void RooUnfoldBayes::Unfold()
 {
-  setup();
-  if (verbose() >= 2) {
-    Print();
-    RooUnfoldResponse::PrintMatrix(_Nji,"RooUnfoldBayes response matrix (Nji)");
-  }
+  // Response-derived quantities are kept if only the measured distribution changed,
+  // and redone if the response object was filled (or reset) since
+  if (_nc<=0 || _resVersion != _res->Version()) setup();
+  _nEstj.ResizeTo(_ne);
+  _nEstj= Vmeasured();
+  if (verbose() >= 2) Print();
   if (verbose() >= 1) cout << "Now unfolding..." << endl;
   unfold();
   if (verbose() >= 2) Print();
@@ -145,17 +329,21 @@ TMatrixD& RooUnfoldBayes::H2M (const TH2* h, TMatrixD& m, Bool_t overflow)
 //-------------------------------------------------------------------------
 void RooUnfoldBayes::setup()
 {
+  // Set up response-dependent quantities: these do not depend on the measured distribution.
   _nc = _nt;
   _ne = _nm;
-
-  _nEstj.ResizeTo(_ne);
-  _nEstj= Vmeasured();
+  _resVersion = _res->Version();
 
   _nCi.ResizeTo(_nt);
   _nCi= _res->Vtruth();
 
-  _Nji.ResizeTo(_ne,_nt);
-  H2M (_res->Hresponse(), _Nji, _overflow);   // don't normalise, which is what _res->Mresponse() would give us
+  // The full response is only needed here: just its bands are kept once they have been extracted
+  TMatrixD Nji(_ne,_nt);          // mapping of causes to effects
+  if (_resToy) {
+    Nji= *_resToy;                // normalised to the truth, like _res->Mresponse()
+    Nji.NormByRow (_nCi, "M");
+  } else
+    H2M (_res->Hresponse(), Nji, _overflow);   // don't normalise, which is what _res->Mresponse() would give us
 
   if (_res->FakeEntries()) {
     TVectorD fakes= _res->Vfakes();
@@ -164,26 +352,163 @@ void RooUnfoldBayes::setup()
     _nc++;
     _nCi.ResizeTo(_nc);
     _nCi[_nc-1]= nfakes;
-    _Nji.ResizeTo(_ne,_nc);
-    for (Int_t i= 0; i<_nm; i++) _Nji(i,_nc-1)= fakes[i];
+    Nji.ResizeTo(_ne,_nc);
+    for (Int_t i= 0; i<_nm; i++) Nji(i,_nc-1)= fakes[i];
   }
+  if (verbose() >= 2) RooUnfoldResponse::PrintMatrix(Nji,"RooUnfoldBayes response matrix (Nji)");
 
   _nbarCi.ResizeTo(_nc);
   _efficiencyCi.ResizeTo(_nc);
-  _Mij.ResizeTo(_nc,_ne);
   _P0C.ResizeTo(_nc);
   _UjInv.ResizeTo(_ne);
-#ifndef OLDERRS
-  if (_dosys!=2) _dnCidnEj.ResizeTo(_nc,_ne);
+
+  // Efficiencies
+  for (Int_t i = 0 ; i < _nc ; i++) {
+    Double_t eff = 0.0;
+    if (_nCi[i] > 0.0) {
+      for (Int_t j = 0 ; j < _ne ; j++) eff += Nji(j,i);
+      eff /= _nCi[i];
+    }
+    _efficiencyCi[i] = eff;
+  }
+
+  // Jet response matrices are banded, so only the non-zero range of each row of the normalised
+  // response, P(E_j|C_i), and of the transpose of P(E_j|C_i)/efficiency_i is stored, and unfold()
+  // only visits those. The fakes cause, if any, fills a whole column and is stored separately
+  // (in double precision even with SetFloatStorage, as it is a single vector).
+  const Int_t ifake= _nc > _nt ? _nc-1 : -1;
+  _iLo.assign (_ne, 0);
+  _iHi.assign (_ne, 0);
+  _jLo.assign (_nc, 0);
+  _jHi.assign (_nc, 0);
+  for (Int_t j = 0 ; j < _ne ; j++) {
+    for (Int_t i = 0 ; i < _nc ; i++) {
+      if (_nCi[i] <= 0.0 || Nji(j,i) == 0.0) continue;
+      if (i != ifake) {
+        if (_iLo[j] == _iHi[j]) _iLo[j]= i;
+        _iHi[j]= i+1;
+      }
+      if (_efficiencyCi[i] > 0.0) {
+        if (_jLo[i] == _jHi[i]) _jLo[i]= j;
+        _jHi[i]= j+1;
+      }
+    }
+  }
+  Int_t iwidth= 0, jwidth= 0;
+  _iBeg.resize (_ne+1);
+  _iBeg[0]= 0;
+  for (Int_t j = 0 ; j < _ne ; j++) {
+    _iBeg[j+1]= _iBeg[j] + _iHi[j]-_iLo[j];
+    if (_iHi[j]-_iLo[j] > iwidth) iwidth= _iHi[j]-_iLo[j];
+  }
+  _jBeg.resize (_nc+1);
+  _jBeg[0]= 0;
+  for (Int_t i = 0 ; i < _nc ; i++) {
+    _jBeg[i+1]= _jBeg[i] + _jHi[i]-_jLo[i];
+    if (_jHi[i]-_jLo[i] > jwidth) jwidth= _jHi[i]-_jLo[i];
+  }
+  if (verbose()>=1) cout << "Response bandwidth " << iwidth << " causes, " << jwidth << " effects" << endl;
+
+  _PEjCi.ResizeTo (_iBeg[_ne]);
+  _PEjCiEffT.ResizeTo (_jBeg[_nc]);
+  _PEfake.ResizeTo (ifake >= 0 ? _ne : 0);
+  for (Int_t j = 0 ; j < _ne ; j++) {
+    Double_t* PEj= _PEjCi.GetMatrixArray() + _iBeg[j];
+    for (Int_t i = _iLo[j] ; i < _iHi[j] ; i++)
+      PEj[i-_iLo[j]] = _nCi[i] > 0.0 ? Nji(j,i) / _nCi[i] : 0.0;  // efficiency of detecting the cause Ci in Effect Ej
+    if (ifake >= 0) _PEfake[j] = _nCi[ifake] > 0.0 ? Nji(j,ifake) / _nCi[ifake] : 0.0;
+  }
+  for (Int_t i = 0 ; i < _nc ; i++) {
+    Double_t* effi= _PEjCiEffT.GetMatrixArray() + _jBeg[i];
+    for (Int_t j = _jLo[i] ; j < _jHi[i] ; j++)
+      effi[j-_jLo[i]] = Nji(j,i) / (_nCi[i] * _efficiencyCi[i]);
+  }
+  _Mij.ResizeTo (_jBeg[_nc]);   // the unfolding matrix has the same band
+  findBlocks();
+
+  if (_float) {
+    ToFloat (_PEjCi,     _PEjCiF);
+    ToFloat (_PEjCiEffT, _PEjCiEffTF);
+#ifndef OLDSYS
+    _PEjCi.ResizeTo(0);   // OLDSYS still multiplies by the double-precision matrix
 #endif
-  if (_dosys)    _dnCidPjk.ResizeTo(_nc,_ne*_nc);
+    _PEjCiEffT.ResizeTo(0);
+  } else {
+    _PEjCiF.ResizeTo(0);
+    _PEjCiEffTF.ResizeTo(0);
+  }
+}
 
-  // Initial distribution
-  _N0C= _nCi.Sum();
-  if (_N0C!=0.0) {
-    _P0C= _nCi;
-    _P0C *= 1.0/_N0C;
+//-------------------------------------------------------------------------
+TMatrixD& RooUnfoldBayes::getPEjCi (TMatrixD& pe) const
+{
+  // Normalised response P(E_j|C_i) as a full matrix, from the band storage.
+  Unpack (_PEjCi.GetMatrixArray(), _iLo, _iHi, _iBeg, 0, _ne, 0, _nc, pe);
+  if (_nc > _nt)
+    for (Int_t j = 0 ; j < _ne ; j++) pe(j,_nc-1)= _PEfake[j];
+  return pe;
+}
+
+//-------------------------------------------------------------------------
+TMatrixD RooUnfoldBayes::UnfoldingMatrix() const
+{
+  // Unfolding matrix (Mij) of the last unfolding, as a full matrix, from the band storage.
+  TMatrixD m;
+  if (Int_t(_jBeg.size()) != _nc+1 || _Mij.GetNrows() != _jBeg[_nc]) return m;
+  return Unpack (_Mij.GetMatrixArray(), _jLo, _jHi, _jBeg, 0, _nc, 0, _ne, m);
+}
+
+//-------------------------------------------------------------------------
+void RooUnfoldBayes::findBlocks()
+{
+  // Finds independent blocks of the response: a boundary is placed between effects j-1 and j
+  // if no effect before j feeds a cause used by an effect from j on, as when several distributions
+  // (eg. rapidity bins) are unfolded together with a block-diagonal response (see RooUnfoldBatch).
+  // The rows of _dnCidnEj are then only stored for the effects of their block.
+  // A fakes cause feeds every effect, so the response is then kept as one block.
+  _blkC.assign (1, 0);
+  _blkE.assign (1, 0);
+  if (_nc == _nt) {
+    std::vector<Int_t> lomin (_ne+1, _nt);   // smallest first cause of effects j.._ne-1
+    for (Int_t j = _ne-1 ; j >= 0 ; j--)
+      lomin[j]= (_iLo[j] < _iHi[j] && _iLo[j] < lomin[j+1]) ? _iLo[j] : lomin[j+1];
+    Int_t himax= 0;                          // largest last cause+1 of effects 0..j-1
+    for (Int_t j = 0 ; j < _ne ; j++) {
+      if (j > _blkE.back() && himax > _blkC.back() && himax <= lomin[j] && lomin[j] < _nt) {
+        _blkE.push_back (j);
+        _blkC.push_back (lomin[j]);
+      }
+      if (_iLo[j] < _iHi[j] && _iHi[j] > himax) himax= _iHi[j];
+    }
+  }
+  _blkC.push_back (_nc);
+  _blkE.push_back (_ne);
+  _kLo.resize (_nc);
+  _kHi.resize (_nc);
+  _kBeg.resize (_nc+1);
+  _kBeg[0]= 0;
+  for (size_t b = 0 ; b+1 < _blkC.size() ; b++) {
+    for (Int_t i = _blkC[b] ; i < _blkC[b+1] ; i++) {
+      _kLo[i]= _blkE[b];
+      _kHi[i]= _blkE[b+1];
+      _kBeg[i+1]= _kBeg[i] + _kHi[i]-_kLo[i];
+    }
   }
+  if (verbose()>=1 && _blkC.size() > 2) cout << "Response has " << _blkC.size()-1 << " independent blocks" << endl;
+}
+
+//-------------------------------------------------------------------------
+Bool_t RooUnfoldBayes::blockDiagonal (const TMatrixD& cov) const
+{
+  // True if the effects covariance matrix has no elements between different blocks of the response.
+  for (size_t b = 0 ; b+1 < _blkE.size() ; b++) {
+    for (Int_t j = _blkE[b] ; j < _blkE[b+1] ; j++) {
+      const Double_t* cj= cov.GetMatrixArray() + j*_ne;
+      for (Int_t k = 0 ;         k < _blkE[b] ; k++) if (cj[k] != 0.0) return kFALSE;
+      for (Int_t k = _blkE[b+1] ; k < _ne ;     k++) if (cj[k] != 0.0) return kFALSE;
+    }
+  }
+  return kTRUE;
 }
 
 //-------------------------------------------------------------------------
@@ -192,22 +517,69 @@ void RooUnfoldBayes::unfold()
   // Calculate the unfolding matrix.
   // _niter = number of iterations to perform (3 by default).
   // _smoothit = smooth the matrix in between iterations (default false).
+  // _tolerance = if >0, stop before _niter iterations once the chi2 of change is below _tolerance.
 
-  TMatrixD PEjCi(_ne,_nc), PEjCiEff(_ne,_nc);
-  for (Int_t i = 0 ; i < _nc ; i++) {
-    if (_nCi[i] <= 0.0) { _efficiencyCi[i] = 0.0; continue; }
-    Double_t eff = 0.0;
-    for (Int_t j = 0 ; j < _ne ; j++) {
-      Double_t response = _Nji(j,i) / _nCi[i];
-      PEjCi(j,i) = PEjCiEff(j,i) = response;  // efficiency of detecting the cause Ci in Effect Ej
-      eff += response;
-    }
-    _efficiencyCi[i] = eff;
-    Double_t effinv = eff > 0.0 ? 1.0/eff : 0.0;   // reset PEjCiEff if eff=0
-    for (Int_t j = 0 ; j < _ne ; j++) PEjCiEff(j,i) *= effinv;
+  // Rows of the M3 work space span the effects of their block, like those of dnCidnEj (see findBlocks)
+  std::vector<Int_t> m3Beg (_ne+1, 0);
+  for (size_t b = 0 ; b+1 < _blkE.size() ; b++)
+    for (Int_t j = _blkE[b] ; j < _blkE[b+1] ; j++) m3Beg[j+1]= m3Beg[j] + _blkE[b+1]-_blkE[b];
+#ifndef OLDERRS
+  if (_dosys!=2) {
+    _dnCidnEj.ResizeTo(_kBeg[_nc]);
+#ifndef OLDMULT
+    // work space for the error propagation, reused for all iterations
+    _M3.ResizeTo(m3Beg[_ne]);
+#endif
   }
+#endif
+  if (_dosys) {
+#ifdef OLDSYS
+    _dnCidPjk.ResizeTo(_nc,_ne*_nc);
+    _dnCidPjk.Zero();
+#else
+    _sysT.clear();
+    _sysU.clear();
+    _sysC.clear();
+    _sysTF.clear();
+    _sysUF.clear();
+    _sysCF.clear();
+    _sysP.clear();
+#endif
+  }
+  _chi2Iter.ResizeTo(_niter);
+  _nbarIter.ResizeTo(_niter);
+  Int_t ndone= _niter;
+  _nbarCiIter.clear();
+  _MijIter.clear();
+  _dnCidnEjIter.clear();
+  _MijIterF.clear();
+  _dnCidnEjIterF.clear();
+
+  // Initial distribution
+  _N0C= _nCi.Sum();
+  if (_N0C!=0.0) {
+    _P0C= _nCi;
+    _P0C *= 1.0/_N0C;
+  } else
+    _P0C.Zero();
 
   TVectorD PbarCi(_nc);
+  TVectorD en(_nc), nr(_nc);
+
+  // Raw arrays: the normalised response and unfolding matrix are stored as the band of each row,
+  // and the error propagation matrices as the block of each row.
+  // With SetFloatStorage, the response is only kept in single precision.
+  const Bool_t    single= _PEjCiF.GetNrows() > 0 || _PEjCiEffTF.GetNrows() > 0;
+  const Double_t* pPE=    _PEjCi.GetMatrixArray();
+  const Double_t* pEffT=  _PEjCiEffT.GetMatrixArray();
+  const Float_t*  pPEF=   _PEjCiF.GetMatrixArray();
+  const Float_t*  pEffTF= _PEjCiEffTF.GetMatrixArray();
+  const Double_t* pPEfk= _PEfake.GetMatrixArray();
+  const Double_t* pnE=   _nEstj.GetMatrixArray();
+  const Double_t* pP0C=  _P0C.GetMatrixArray();
+  Double_t*       pUinv= _UjInv.GetMatrixArray();
+  Double_t*       pM=    _Mij.GetMatrixArray();
+  const Int_t     ifake= _nc > _nt ? _nc-1 : -1;
 
   for (Int_t kiter = 0 ; kiter < _niter; kiter++) {
 
@@ -219,25 +591,13 @@ void RooUnfoldBayes::unfold()
       _N0C = _nbartrue;
     }
 
-    for (Int_t j = 0 ; j < _ne ; j++) {
-      Double_t Uj = 0.0;
-      for (Int_t i = 0 ; i < _nc ; i++)
-        Uj += PEjCi(j,i) * _P0C[i];
-      _UjInv[j] = Uj > 0.0 ? 1.0/Uj : 0.0;
-    }
+    // Folded prior, from the non-zero range of each row of PEjCi
+    if (single) FoldPrior (pPEF, pPEfk, pP0C, _iLo, _iHi, _iBeg, _ne, ifake, pUinv);
+    else        FoldPrior (pPE,  pPEfk, pP0C, _iLo, _iHi, _iBeg, _ne, ifake, pUinv);
 
-    // Unfolding matrix M
-    _nbartrue = 0.0;
-    for (Int_t i = 0 ; i < _nc ; i++) {
-      Double_t nbarC = 0.0;
-      for (Int_t j = 0 ; j < _ne ; j++) {
-        Double_t Mij = _UjInv[j] * PEjCiEff(j,i) * _P0C[i];
-        _Mij(i,j) = Mij;
-        nbarC += Mij * _nEstj[j];
-      }
-      _nbarCi[i] = nbarC;
-      _nbartrue += nbarC;  // best estimate of true number of events
-    }
+    // Unfolding matrix M, filled row by row together with the new estimate
+    if (single) _nbartrue= FillUnfoldingMatrix (pEffTF, pUinv, pP0C, pnE, _jLo, _jHi, _jBeg, _nc, pM, _nbarCi.GetMatrixArray());
+    else        _nbartrue= FillUnfoldingMatrix (pEffT,  pUinv, pP0C, pnE, _jLo, _jHi, _jBeg, _nc, pM, _nbarCi.GetMatrixArray());
 
     // new estimate of true distribution
     PbarCi= _nbarCi;
@@ -245,64 +605,97 @@ void RooUnfoldBayes::unfold()
 
 #ifndef OLDERRS
     if (_dosys!=2) {
+      Double_t* pdnw= _dnCidnEj.GetMatrixArray();
       if (kiter <= 0) {
-        _dnCidnEj= _Mij;
+        // dnCidnEj = Mij, whose band is inside the block of each row
+        _dnCidnEj.Zero();
+        for (Int_t i = 0 ; i < _nc ; i++)
+          for (Int_t j = _jLo[i] ; j < _jHi[i] ; j++) pdnw[_kBeg[i]+j-_kLo[i]]= pM[_jBeg[i]+j-_jLo[i]];
       } else {
 #ifndef OLDMULT
-        TVectorD en(_nc), nr(_nc);
+        en.Zero();
+        nr.Zero();
         for (Int_t i = 0 ; i < _nc ; i++) {
           if (_P0C[i]<=0.0) continue;
           Double_t ni= 1.0/(_N0C*_P0C[i]);
           en[i]= -ni*_efficiencyCi[i];
           nr[i]=  ni*_nbarCi[i];
         }
-        TMatrixD M1= _dnCidnEj;
-        M1.NormByColumn(nr,"M");
-        TMatrixD M2 (TMatrixD::kTransposed, _Mij);
-        M2.NormByColumn(_nEstj,"M");
-        M2.NormByRow(en,"M");
-        TMatrixD M3 (M2, TMatrixD::kMult, _dnCidnEj);
-        _dnCidnEj.Mult (_Mij, M3);
-        _dnCidnEj += _Mij;
-        _dnCidnEj += M1;
+        // M3 = M2 * dnCidnEj, summing only over the non-zero causes of each effect, where
+        // M2 = Mij^T scaled by nEstj (rows) and en (columns) is taken from the band of Mij as needed.
+        // The causes of an effect are all in its block, so each row of M3 only spans the effects of that block.
+        Double_t* pM3= _M3.GetMatrixArray();
+        _M3.Zero();
+        for (Int_t j = 0 ; j < _ne ; j++) {
+          Double_t* M3j= pM3 + m3Beg[j];
+          for (Int_t i = _iLo[j] ; i <= _iHi[j] ; i++) {
+            Int_t ii= i < _iHi[j] ? i : ifake;
+            if (ii<0) break;
+            if (j < _jLo[ii] || j >= _jHi[ii]) continue;   // outside the band of Mij
+            const Double_t a= pM[_jBeg[ii]+j-_jLo[ii]] * pnE[j] * en[ii];
+            if (a==0.0) continue;
+            const Double_t* dni= pdnw + _kBeg[ii];
+            for (Int_t k = 0, nk= _kHi[ii]-_kLo[ii] ; k < nk ; k++) M3j[k] += a * dni[k];
+          }
+        }
+        // dnCidnEj = Mij + diag(nr) * dnCidnEj + Mij * M3, summing only over the band of each row of Mij
+        for (Int_t i = 0 ; i < _nc ; i++) {
+          const Double_t* Mi= pM + _jBeg[i];
+          Double_t* dni= pdnw + _kBeg[i];
+          const Int_t klo= _kLo[i], nk= _kHi[i]-klo, jlo= _jLo[i], jhi= _jHi[i];
+          for (Int_t k = 0 ; k < nk ; k++) dni[k] *= nr[i];
+          for (Int_t j = jlo ; j < jhi ; j++) dni[j-klo] += Mi[j-jlo];
+          for (Int_t j = jlo ; j < jhi ; j++) {
+            const Double_t a= Mi[j-jlo];
+            if (a==0.0) continue;
+            const Double_t* M3j= pM3 + m3Beg[j];
+            for (Int_t k = 0 ; k < nk ; k++) dni[k] += a * M3j[k];
+          }
+        }
 #else /* OLDMULT */
+        TMatrixD Mij= UnfoldingMatrix(), dnCidnEj;
+        Unpack (pdnw, _kLo, _kHi, _kBeg, 0, _nc, 0, _ne, dnCidnEj);
         TVectorD ksum(_ne);
         for (Int_t j = 0 ; j < _ne ; j++) {
           for (Int_t k = 0 ; k < _ne ; k++) {
             Double_t sum = 0.0;
             for (Int_t l = 0 ; l < _nc ; l++) {
-              if (_P0C[l]>0.0) sum += _efficiencyCi[l]*_Mij(l,k)*_dnCidnEj(l,j)/_P0C[l];
+              if (_P0C[l]>0.0) sum += _efficiencyCi[l]*Mij(l,k)*dnCidnEj(l,j)/_P0C[l];
             }
             ksum[k]= sum;
           }
           for (Int_t i = 0 ; i < _nc ; i++) {
-            Double_t dsum = _P0C[i]>0 ? _dnCidnEj(i,j)*_nbarCi[i]/_P0C[i] : 0.0;
+            Double_t dsum = _P0C[i]>0 ? dnCidnEj(i,j)*_nbarCi[i]/_P0C[i] : 0.0;
             for (Int_t k = 0 ; k < _ne ; k++) {
-              dsum -= _Mij(i,k)*_nEstj[k]*ksum[k];
+              dsum -= Mij(i,k)*_nEstj[k]*ksum[k];
             }
             // update dnCidnEj. Note that we can do this in-place due to the ordering of the accesses.
-            _dnCidnEj(i,j) = _Mij(i,j) + dsum/_N0C;
+            dnCidnEj(i,j) = Mij(i,j) + dsum/_N0C;
           }
         }
+        Pack (dnCidnEj, _kLo, _kHi, _kBeg, pdnw);
 #endif
       }
     }
 #endif
 
     if (_dosys) {
+#ifdef OLDSYS
+      TMatrixD Mij= UnfoldingMatrix();
 #ifndef OLDERRS2
       if (kiter > 0) {
         TVectorD mbyu(_ne);
         for (Int_t j = 0 ; j < _ne ; j++) {
           mbyu[j]= _UjInv[j]*_nEstj[j]/_N0C;
         }
-        TMatrixD A= _Mij;
+        TMatrixD A= Mij;
         A.NormByRow (mbyu, "M");
-        TMatrixD B(A, TMatrixD::kMult, PEjCi);
+        TMatrixD PEjCi;
+        TMatrixD B(A, TMatrixD::kMult, getPEjCi (PEjCi));
         TMatrixD dnCidPjkUpd (B, TMatrixD::kMult, _dnCidPjk);
         Int_t nec= _ne*_nc;
         for (Int_t i = 0 ; i < _nc ; i++) {
-          if (_P0C[i]<=0.0) continue;  // skip loop: dnCidPjkUpd(i,jk) will also be 0 because _Mij(i,j) will be 0
+          if (_P0C[i]<=0.0) continue;  // skip loop: dnCidPjkUpd(i,jk) will also be 0 because Mij(i,j) will be 0
           Double_t r= PbarCi[i]/_P0C[i];
           for (Int_t jk= 0; jk<nec; jk++)
             _dnCidPjk(i,jk)= r*_dnCidPjk(i,jk) - dnCidPjkUpd(i,jk);
@@ -316,12 +709,49 @@ void RooUnfoldBayes::unfold()
         Double_t mbyu= _UjInv[j]*_nEstj[j];
         Int_t j0= j*_nc;
         for (Int_t i = 0 ; i < _nc ; i++) {
-          Double_t b= -mbyu * _Mij(i,j);
+          Double_t b= -mbyu * Mij(i,j);
           for (Int_t k = 0 ; k < _nc ; k++) _dnCidPjk(i,j0+k) += b*_P0C[k];
           if (_efficiencyCi[i]!=0.0)
             _dnCidPjk(i,j0+i) += (_P0C[i]*mbyu - _nbarCi[i]) / _efficiencyCi[i];
         }
       }
+#else  /* OLDSYS */
+      // Keep the factors of dnCidPjk rather than the nc x (ne*nc) matrix itself: see sysCovariance().
+#ifndef OLDERRS2
+      if (kiter > 0) {
+        // dnCidPjk -> T * dnCidPjk, T = diag(PbarCi/P0C) - Mij * diag(mbyu) * PEjCi
+        TVectorD mbyu(_ne);
+        for (Int_t j = 0 ; j < _ne ; j++) {
+          mbyu[j]= _UjInv[j]*_nEstj[j]/_N0C;
+        }
+        TMatrixD T;
+        if (single) MinusBandProduct (pM, mbyu.GetMatrixArray(), pPEF, pPEfk, _jLo, _jHi, _jBeg, _iLo, _iHi, _iBeg, _nc, ifake, T);
+        else        MinusBandProduct (pM, mbyu.GetMatrixArray(), pPE,  pPEfk, _jLo, _jHi, _jBeg, _iLo, _iHi, _iBeg, _nc, ifake, T);
+        for (Int_t i = 0 ; i < _nc ; i++)
+          T(i,i) += _P0C[i]>0.0 ? PbarCi[i]/_P0C[i] : 1.0;
+        Keep (_sysT, _sysTF, single, T);
+      } else
+        Keep (_sysT, _sysTF, single, TMatrixD());
+#else  /* OLDERRS2 */
+      if (kiter == _niter-1)   // used to only calculate _dnCidPjk for the final iteration
+#endif
+      {
+        // dnCidPjk += block j: -u(:,j) * P0C^T + diag(c(:,j))
+        TMatrixD u(_nc,_ne), c(_nc,_ne);
+        for (Int_t j = 0 ; j < _ne ; j++) {
+          if (_UjInv[j]==0.0) continue;
+          Double_t mbyu= _UjInv[j]*_nEstj[j];
+          for (Int_t i = 0 ; i < _nc ; i++) {
+            if (j >= _jLo[i] && j < _jHi[i]) u(i,j)= mbyu * pM[_jBeg[i]+j-_jLo[i]];
+            if (_efficiencyCi[i]!=0.0)
+              c(i,j)= (_P0C[i]*mbyu - _nbarCi[i]) / _efficiencyCi[i];
+          }
+        }
+        Keep (_sysU, _sysUF, single, u);
+        Keep (_sysC, _sysCF, single, c);
+        _sysP.push_back (_P0C);
+      }
+#endif
     }
 
     // no need to smooth the last iteraction
@@ -330,9 +760,58 @@ void RooUnfoldBayes::unfold()
     // Chi2 based on Poisson errors
     Double_t chi2 = getChi2(PbarCi, _P0C, _nbartrue);
     if (verbose()>=1) cout << "Chi^2 of change " << chi2 << endl;
+    _chi2Iter[kiter]= chi2;
+    _nbarIter[kiter]= _nbartrue;
+    if (_keepIter) {
+      _nbarCiIter.push_back (_nbarCi);
+      Keep (_MijIter, _MijIterF, single, _Mij);
+#ifndef OLDERRS
+      if (_dosys!=2) Keep (_dnCidnEjIter, _dnCidnEjIterF, single, _dnCidnEj);
+#endif
+    }
+
+    if (_tolerance>0.0 && chi2<_tolerance) {
+      ndone= kiter+1;
+      if (verbose()>=1) cout << "Converged after " << ndone << " iterations" << endl;
+      break;
+    }
 
     // and repeat
   }
+  _chi2Iter.ResizeTo(ndone);
+  _nbarIter.ResizeTo(ndone);
+  _nsys= ndone;
+}
+
+//-------------------------------------------------------------------------
+Bool_t RooUnfoldBayes::RestoreIteration (Int_t niter)
+{
+  // Set the result, and the errors calculated from now on, to those for niter iterations,
+  // using the state kept by the last unfolding with KeepIterations().
+  // niter can be up to the number of iterations done, or more if they stopped at the tolerance.
+  // Returns false, changing nothing, if that state is not available.
+  if (!_keepIter || niter<1) return kFALSE;
+  Vreco();   // unfold now if not yet done since KeepIterations
+  if (!_unfolded) return kFALSE;
+  Int_t ndone= _nbarCiIter.size();
+  if (ndone==0) return kFALSE;
+  if (niter>ndone && !(_tolerance>0.0 && _chi2Iter[ndone-1]<_tolerance)) return kFALSE;
+#if defined(OLDSYS) || defined(OLDERRS2)
+  if (_dosys && niter!=ndone) return kFALSE;   // response error terms only kept for the final iteration
+#endif
+  Int_t k= (niter < ndone ? niter : ndone) - 1;
+  _nbarCi=   _nbarCiIter[k];
+  TVectorD work;
+  _Mij=      Kept (_MijIter, _MijIterF, k, work);
+  if (!_dnCidnEjIter.empty() || !_dnCidnEjIterF.empty()) _dnCidnEj= Kept (_dnCidnEjIter, _dnCidnEjIterF, k, work);
+  _nbartrue= _nbarIter[k];
+  _nsys=     k+1;
+  _niter=    niter;
+  _rec.ResizeTo(_nc);
+  _rec = _nbarCi;
+  _rec.ResizeTo(_nt);  // drop fakes in final bin
+  _haveCov= _haveWgt= _haveErrors= _have_err_mat= kFALSE;
+  return kTRUE;
 }
 
 //-------------------------------------------------------------------------
@@ -344,22 +823,42 @@ void RooUnfoldBayes::getCovariance()
     // Create the covariance matrix of result from that of the measured distribution
     _cov.ResizeTo (_nc, _nc);
 #ifdef OLDERRS
-    const TMatrixD& Dprop= _Mij;
+    const Double_t* Dprop= _Mij.GetMatrixArray();
+    const std::vector<Int_t> &dLo= _jLo, &dHi= _jHi, &dBeg= _jBeg;
 #else
-    const TMatrixD& Dprop= _dnCidnEj;
+    const Double_t* Dprop= _dnCidnEj.GetMatrixArray();
+    const std::vector<Int_t> &dLo= _kLo, &dHi= _kHi, &dBeg= _kBeg;
 #endif
-    if (_haveCovMes) {
-      ABAT (Dprop, GetMeasuredCov(), _cov);
-    } else {
-      TVectorD v= Emeasured();
+    TMatrixD D;
+    TVectorD v;
+    if (!_haveCovMes) {
+      v.ResizeTo (_ne);
+      v= Emeasured();
       v.Sqr();
-      ABAT (Dprop, v, _cov);
+    }
+    Int_t nblk= _blkC.size()-1;
+    if (nblk>1 && (!_haveCovMes || blockDiagonal (GetMeasuredCov()))) {
+      // Independent blocks: propagate each one separately, the covariance between blocks is zero
+      _cov.Zero();
+      for (Int_t b = 0 ; b < nblk ; b++) {
+        Int_t c0= _blkC[b], c1= _blkC[b+1]-1, e0= _blkE[b], e1= _blkE[b+1]-1;
+        TMatrixD covb;
+        Unpack (Dprop, dLo, dHi, dBeg, c0, c1-c0+1, e0, e1-e0+1, D);
+        if (_haveCovMes) ABAT (D, GetMeasuredCov().GetSub (e0, e1, e0, e1), covb);
+        else             ABAT (D, v.GetSub (e0, e1), covb);
+        _cov.SetSub (c0, c0, covb);
+      }
+    } else if (_haveCovMes) {
+      ABAT (Unpack (Dprop, dLo, dHi, dBeg, 0, _nc, 0, _ne, D), GetMeasuredCov(), _cov);
+    } else {
+      ABAT (Unpack (Dprop, dLo, dHi, dBeg, 0, _nc, 0, _ne, D), v, _cov);
     }
   }
 
   if (_dosys) {
     if (verbose()>=1) cout << "Calculating covariance due to unfolding matrix..." << endl;
 
+#ifdef OLDSYS
     const TMatrixD& Eres= _res->Eresponse();
     TVectorD Vjk(_ne*_nc);           // vec(Var(j,k))
     for (Int_t j = 0 ; j < _ne ; j++) {
@@ -378,7 +877,108 @@ void RooUnfoldBayes::getCovariance()
       _cov.ResizeTo (_nc, _nc);
       ABAT (_dnCidPjk, Vjk, _cov);
     }
+#else
+    if (_dosys!=2) {
+      TMatrixD covres(_nc,_nc);
+      sysCovariance (covres);
+      _cov += covres;
+    } else
+      sysCovariance (_cov);
+#endif
+  }
+}
+
+//-------------------------------------------------------------------------
+void RooUnfoldBayes::sysCovariance (TMatrixD& cov) const
+{
+  // Covariance due to the response matrix errors, sum_jk dnCi/dPjk Var(Pjk) dnCl/dPjk,
+  // without forming the nc x (ne*nc) matrix dnCi/dPjk.
+  // Iteration t adds the source term S_t, whose block j is -u_t(:,j) p_t^T + diag(c_t(:,j)),
+  // and later iterations multiply by T_t, so dnCi/dPjk = sum_t Q_t S_t with Q_t = T_{n-1}...T_{t+1}.
+  // With W_t = Q_t u_t and V(j,k) = Var(Pjk), summing over the blocks gives
+  //   cov = sum_{t,s} W_t diag(g_ts) W_s^T + Q_t diag(z_ts) Q_s^T - X_ts - X_ts^T
+  // where g_ts(j) = sum_k V(j,k) p_t(k) p_s(k), z_ts(k) = sum_j V(j,k) c_t(k,j) c_s(k,j),
+  // and X_ts = W_t Y_ts^T Q_s^T with Y_ts(k,j) = V(j,k) p_t(k) c_s(k,j).
+  // Memory is O(niter*nc*(nc+ne)) instead of O(nc*nc*ne). With SetFloatStorage, the Q_t and W_t are also
+  // kept in single precision, and each is converted back to double precision as it is used.
+  const Bool_t single= !_sysUF.empty();
+  Int_t n= single ? _sysUF.size() : _sysU.size();
+  if (n>_nsys) n= _nsys;   // see RestoreIteration
+  cov.ResizeTo (_nc, _nc);
+  cov.Zero();
+  if (n==0) return;
+
+  const TMatrixD& Eres= _res->Eresponse();
+  TMatrixD V(_ne,_nc);   // no response error on the fakes cause
+  for (Int_t j = 0 ; j < _ne ; j++) {
+    for (Int_t i = 0 ; i < _nt ; i++) {
+      Double_t e= Eres(j,i);
+      V(j,i)= e*e;
+    }
+  }
+
+  // Q_t is kept in reverse order, starting with Q_{n-1}=1
+  std::vector<TMatrixD> Q, W;
+  std::vector<TMatrixF> QF, WF;
+  TMatrixD q(_nc,_nc), qt(_nc,_nc), wt(_nc,_ne), work, work2;
+  q.UnitMatrix();
+  Keep (Q, QF, single, q);
+  for (Int_t t = n-1 ; t > 0 ; t--) {
+    qt.Mult (q, Kept (_sysT, _sysTF, t, work));
+    q= qt;
+    Keep (Q, QF, single, q);
   }
+  for (Int_t t = 0 ; t < n ; t++) {
+    wt.Mult (Kept (Q, QF, n-1-t, work), Kept (_sysU, _sysUF, t, work2));
+    Keep (W, WF, single, wt);
+  }
+
+  TVectorD g(_ne), z(_nc);
+  TMatrixD Y(_nc,_ne);
+  TMatrixD Wtw, Qtw, ctw, Wsw, Qsw, csw;   // work space for terms kept in single precision
+  for (Int_t t = 0 ; t < n ; t++) {
+    const TVectorD& pt= _sysP[t];
+    const TMatrixD& Wt= Kept (W, WF, t, Wtw);
+    const TMatrixD& Qt= Kept (Q, QF, n-1-t, Qtw);
+    const TMatrixD& ct= Kept (_sysC, _sysCF, t, ctw);
+    for (Int_t s = 0 ; s < n ; s++) {
+      const TVectorD& ps= _sysP[s];
+      const TMatrixD& Ws= s==t ? Wt : Kept (W, WF, s, Wsw);
+      const TMatrixD& Qs= s==t ? Qt : Kept (Q, QF, n-1-s, Qsw);
+      const TMatrixD& cs= s==t ? ct : Kept (_sysC, _sysCF, s, csw);
+      g.Zero();
+      z.Zero();
+      for (Int_t j = 0 ; j < _ne ; j++) {
+        for (Int_t k = 0 ; k < _nc ; k++) {
+          Double_t v= V(j,k);
+          g[j] += v*pt[k]*ps[k];
+          z[k] += v*ct(k,j)*cs(k,j);
+          Y(k,j)= v*pt[k]*cs(k,j);
+        }
+      }
+      addADBT (Wt, g, Ws, cov);
+      addADBT (Qt, z, Qs, cov);
+      TMatrixD WY (Wt, TMatrixD::kMultTranspose, Y);
+      TMatrixD X  (WY, TMatrixD::kMultTranspose, Qs);
+      cov -= X;
+      X.T();
+      cov -= X;
+    }
+  }
+}
+
+TMatrixD& RooUnfoldBayes::addADBT (const TMatrixD& a, const TVectorD& d, const TMatrixD& b, TMatrixD& c)
+{
+  // Adds a * diag(d) * b^T to c
+  if (&a == &b) {
+    TMatrixD ada;
+    c += ABAT (a, d, ada);
+    return c;
+  }
+  TMatrixD ad= a;
+  ad.NormByRow (d, "M");
+  c += TMatrixD (ad, TMatrixD::kMultTranspose, b);
+  return c;
 }
 
 //-------------------------------------------------------------------------
@@ -394,7 +994,11 @@ void RooUnfoldBayes::smooth(TVectorD& PbarCi) const
     return;
   }
   if (verbose()>=1) cout << "Smoothing." << endl;
-  TH1::SmoothArray (_nc, PbarCi.GetMatrixArray(), 1);
+  // Smooth each independent block separately, so as not to mix distributions packed together
+  for (size_t b = 0 ; b+1 < _blkC.size() ; b++) {
+    Int_t n= _blkC[b+1]-_blkC[b];
+    if (n >= 3) TH1::SmoothArray (n, PbarCi.GetMatrixArray()+_blkC[b], 1);
+  }
   return;
 }
 
@@ -442,6 +1046,9 @@ void RooUnfoldBayes::Print(Option_t* option) const
 
   cout << "Output (unfolded):" << endl;
   cout << "  Total Number of events : " << _nbarCi.Sum() <<endl;
+  if (_chi2Iter.GetNrows()>0)
+    cout << "  Iterations done        : " << _chi2Iter.GetNrows()
+         << " (chi2 of change " << _chi2Iter[_chi2Iter.GetNrows()-1] << ")" << endl;
 
   cout << "-------------------------------------------\n" << endl;
 
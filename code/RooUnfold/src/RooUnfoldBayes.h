@@ -16,6 +16,9 @@
 
 #include "TVectorD.h"
 #include "TMatrixD.h"
+#include "TMatrixF.h"
+#include "TVectorF.h"
+#include <vector>
 
 class TH1;
 class TH2;
@@ -41,12 +44,24 @@ public:
 
   void SetIterations (Int_t niter= 4);
   void SetSmoothing  (Bool_t smoothit= false);
+  void SetTolerance  (Double_t tol= 0.0);
   Int_t GetIterations() const;
   Int_t GetSmoothing()  const;
-  const TMatrixD& UnfoldingMatrix() const;
+  Double_t GetTolerance() const;
+  Int_t GetIterationsDone() const;
+  const TVectorD& Chi2History() const;
+  const TVectorD& NtrueHistory() const;
+  void KeepIterations (Bool_t keep= true);
+  void SetFloatStorage (Bool_t single= true);
+  Bool_t GetFloatStorage() const;
+  Bool_t RestoreIteration (Int_t niter);
+  TMatrixD UnfoldingMatrix() const;
 
   virtual void  SetRegParm (Double_t parm);
   virtual Double_t GetRegParm() const;
+  virtual void SetResponse (const RooUnfoldResponse* res);
+  virtual Bool_t SetResponseToy (const TMatrixD* mres);
+  using RooUnfold::SetResponse;
   virtual void Reset();
   virtual void Print (Option_t* option= "") const;
 
@@ -57,10 +72,16 @@ protected:
   virtual void Unfold();
   virtual void GetCov();
   virtual void GetSettings();
+  virtual Bool_t ToysInThreads() const;
 
   void setup();
   void unfold();
   void getCovariance();
+  void sysCovariance (TMatrixD& cov) const;
+  void findBlocks();
+  TMatrixD& getPEjCi (TMatrixD& pe) const;
+  Bool_t blockDiagonal (const TMatrixD& cov) const;
+  static TMatrixD& addADBT (const TMatrixD& a, const TVectorD& d, const TMatrixD& b, TMatrixD& c);
 
   void smooth(TVectorD& PbarCi) const;
   Double_t getChi2(const TVectorD& prob1,
@@ -75,9 +96,12 @@ protected:
   // instance variables
   Int_t _niter;
   Int_t _smoothit;
+  Double_t _tolerance;    // stop once the chi2 of change is below this, _niter is then the maximum (0: always do _niter)
+  Bool_t _float;          // keep the response band and the terms kept for each iteration in single precision
 
   Int_t _nc;              // number of causes  (same as _nt)
   Int_t _ne;              // number of effects (same as _nm)
+  Int_t _resVersion;      //! RooUnfoldResponse::Version() of the response when setup() was done
   Double_t _N0C;          // number of events in prior
   Double_t _nbartrue;     // best estimate of number of true events
 
@@ -88,15 +112,39 @@ protected:
   TVectorD _P0C;          // prior before last iteration
   TVectorD _UjInv;        // 1 / (folded prior) from last iteration
 
-  TMatrixD _Nji;          // mapping of causes to effects
-  TMatrixD _Mij;          // unfolding matrix
+  TVectorD _Mij;          // unfolding matrix: band [_jLo[i],_jHi[i]) of each row i, from _jBeg[i]
   TMatrixD _Vij;          // covariance matrix
   TMatrixD _VnEstij;      // covariance matrix of effects
-  TMatrixD _dnCidnEj;     // measurement error propagation matrix
-  TMatrixD _dnCidPjk;     // response error propagation matrix (stack j,k into each column)
+  TVectorD _dnCidnEj;     // measurement error propagation matrix: block [_kLo[i],_kHi[i]) of each row i, from _kBeg[i]
+  TMatrixD _dnCidPjk;     // response error propagation matrix (stack j,k into each column), only filled with OLDSYS
+  TVectorD _PEjCi;        //! normalised response, P(E_j|C_i): band [_iLo[j],_iHi[j]) of each row j, from _iBeg[j]
+  TVectorD _PEjCiEffT;    //! transpose of P(E_j|C_i)/efficiency_i: band [_jLo[i],_jHi[i]) of each row i, from _jBeg[i]
+  TVectorD _PEfake;       //! fakes column of P(E_j|C_i), if any
+  TVectorF _PEjCiF;       //! _PEjCi in single precision, with SetFloatStorage
+  TVectorF _PEjCiEffTF;   //! _PEjCiEffT in single precision, with SetFloatStorage
+  TVectorD _M3;           //! work space for _dnCidnEj update, with the effects of its block in each row
+  std::vector<Int_t> _iLo, _iHi; //! non-zero cause range [lo,hi) in each row of _PEjCi, not counting fakes
+  std::vector<Int_t> _jLo, _jHi; //! non-zero effect range [lo,hi) in each row of _PEjCiEffT
+  std::vector<Int_t> _iBeg, _jBeg; //! start of each row in _PEjCi and _PEjCiEffT, and their sizes
+  std::vector<Int_t> _blkC, _blkE; //! first cause and effect of each independent block of the response, and _nc, _ne
+  std::vector<Int_t> _kLo, _kHi; //! effect range [lo,hi) of the block of each cause
+  std::vector<Int_t> _kBeg;      //! start of each row in _dnCidnEj, and its size
+  std::vector<TMatrixD> _sysT;   //! _dnCidPjk propagation matrix of each iteration
+  std::vector<TMatrixD> _sysU;   //! _dnCidPjk source term of each iteration, rank-one part
+  std::vector<TMatrixD> _sysC;   //! _dnCidPjk source term of each iteration, diagonal part
+  std::vector<TVectorD> _sysP;   //! prior used for each source term
+  TVectorD _chi2Iter;     //! chi2 of change after each iteration done
+  TVectorD _nbarIter;     //! estimated number of true events after each iteration done
+  Bool_t _keepIter;       //! keep the state after each iteration for RestoreIteration
+  Int_t  _nsys;           //! number of iterations of _sys* used by sysCovariance
+  std::vector<TVectorD> _nbarCiIter;   //! _nbarCi after each iteration, if _keepIter
+  std::vector<TVectorD> _MijIter;      //! _Mij after each iteration, if _keepIter
+  std::vector<TVectorD> _dnCidnEjIter; //! _dnCidnEj after each iteration, if _keepIter
+  std::vector<TMatrixF> _sysTF, _sysUF, _sysCF;     //! _sysT, _sysU, _sysC in single precision, with SetFloatStorage
+  std::vector<TVectorF> _MijIterF, _dnCidnEjIterF;  //! _MijIter, _dnCidnEjIter in single precision, with SetFloatStorage
 
 public:
-  ClassDef (RooUnfoldBayes, 1) // Bayesian Unfolding
+  ClassDef (RooUnfoldBayes, 4) // Bayesian Unfolding
 };
 
 // Inline method definitions
@@ -148,6 +196,14 @@ void RooUnfoldBayes::SetSmoothing (Bool_t smoothit)
   _smoothit= smoothit;
 }
 
+inline
+void RooUnfoldBayes::SetTolerance (Double_t tol)
+{
+  // Stop iterating once the chi2 of change falls below tol, with at most GetIterations() iterations.
+  // tol=0 (the default) always does GetIterations() iterations.
+  _tolerance= tol;
+}
+
 inline
 Int_t RooUnfoldBayes::GetIterations() const
 {
@@ -163,10 +219,63 @@ Int_t RooUnfoldBayes::GetSmoothing()  const
 }
 
 inline
-const TMatrixD& RooUnfoldBayes::UnfoldingMatrix() const
+Double_t RooUnfoldBayes::GetTolerance() const
+{
+  // Return chi2 of change at which to stop iterating (0 if not used)
+  return _tolerance;
+}
+
+inline
+Int_t RooUnfoldBayes::GetIterationsDone() const
+{
+  // Return number of iterations done in the last unfolding
+  return _chi2Iter.GetNrows();
+}
+
+inline
+const TVectorD& RooUnfoldBayes::Chi2History() const
+{
+  // Access chi2 of change after each iteration of the last unfolding
+  return _chi2Iter;
+}
+
+inline
+const TVectorD& RooUnfoldBayes::NtrueHistory() const
+{
+  // Access estimated number of true events after each iteration of the last unfolding
+  return _nbarIter;
+}
+
+inline
+void RooUnfoldBayes::KeepIterations (Bool_t keep)
+{
+  // Keep the state after each iteration of the next unfolding, so RestoreIteration can return to it
+  _keepIter= keep;
+  _unfolded= kFALSE;
+}
+
+inline
+void RooUnfoldBayes::SetFloatStorage (Bool_t single)
+{
+  // Keep the band of the normalised response, and the terms kept for each iteration, in single precision.
+  // The current unfolding and error propagation matrices stay in double precision. Sums are still done in double precision.
+  _float= single;
+  _nc= _ne= 0;
+  _unfolded= kFALSE;
+}
+
+inline
+Bool_t RooUnfoldBayes::GetFloatStorage() const
+{
+  // Return single-precision storage setting
+  return _float;
+}
+
+inline
+Bool_t RooUnfoldBayes::ToysInThreads() const
 {
-  // Access unfolding matrix (Mij)
-  return _Mij;
+  // Copies only read the shared response object (after RooUnfold::PrepareToys), so can unfold in separate threads
+  return kTRUE;
 }
 
 inline
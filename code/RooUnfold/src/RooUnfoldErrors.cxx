@@ -25,6 +25,12 @@ maths needed to plot these graphs. The object requires the number of toys over w
 <p> If the true distribution is known then a plot of the chi squared values can also be returned (Chi2()).
  This requires the inclusion of the truth distribution and the error method on which the chi squared is based 
  (0 for a simple calculation, 1 or 2 for a method based on the covariance matrix, depending on the method used for calculation of errors.). </p>
+<p>With a truth distribution, the toys are shared between the unfolding object's NThreads() threads
+(for the algorithms that allow it, RooUnfoldBayes and RooUnfoldInvert), using its ToySeed(), so the results
+only depend on the number of threads through rounding. Only running sums are kept: the mean and covariance
+of the unfolded results (ToyMean() and ToyCovariance()), the mean unfolding error in each bin, and one chi squared value per toy.
+The output histograms and the chi squared TNtuple are made from these at the end.
+Chi2Quantile(p) gives quantiles of the chi squared distribution without making the TNtuple.</p>
 <p>On some occasions the chi squared value can be very large. This is due to the covariance matrices being near singular and thus 
 difficult to invert reliably. A warning will be displayed if this is the case. To plot the chi squared distribution use the option Draw("chi2"), to filter out the larger values use Draw("chi2","abs(chi2 < max") where max is the largest value to be included.</p> 
 END_HTML */
@@ -35,17 +41,20 @@ END_HTML */
 #include <iostream>
 #include <cmath>
 #include <vector>
+#include <algorithm>
+#include <thread>
 
+#include "TRandom.h"
 #include "TString.h"
 #include "TStyle.h"
 #include "TH1D.h"
-#include "TProfile.h"
 #include "TNtuple.h"
 #include "TAxis.h"
 
 #include "RooUnfoldResponse.h"
 #include "RooUnfold.h"
 #include "RooUnfoldResponse.h"
+#include "RooUnfoldToys.h"
 
 using std::cout;
 using std::cerr;
@@ -92,12 +101,33 @@ RooUnfoldErrors::GraphParameters()
 TNtuple*
 RooUnfoldErrors::Chi2()
 {   
-    if (!hchi2) return hchi2;
     //Returns TNtuple of chi squared values. 
+    if (!hchi2 && !chi2val.empty()) {
+      hchi2= new TNtuple ("chi2", "chi2", "chi2");
+      hchi2->SetDirectory(0);
+      for (size_t k=0; k<chi2val.size(); k++) hchi2->Fill(chi2val[k]);
+    }
+    if (!hchi2) return hchi2;
     hchi2->SetFillColor(4);
     return hchi2;
 }
 
+Double_t
+RooUnfoldErrors::Chi2Quantile (Double_t p) const
+{
+    //Returns quantile p (0<=p<=1) of the toy chi squared values.
+    if (chi2val.empty()) return 0.0;
+    std::vector<Float_t> v (chi2val);
+    Double_t x= p*(v.size()-1);
+    if (x<0.0) x= 0.0;
+    size_t i= size_t(x);
+    if (i>=v.size()-1) return *std::max_element (v.begin(), v.end());
+    std::nth_element (v.begin(), v.begin()+i, v.end());
+    Double_t lo= v[i];
+    Double_t hi= *std::min_element (v.begin()+i+1, v.end());
+    return lo + (x-i)*(hi-lo);
+}
+
 TH1*
 RooUnfoldErrors::RMSResiduals(){
     if (!h_err_res) return h_err_res;
@@ -145,58 +175,98 @@ RooUnfoldErrors::CreatePlots()
 void
 RooUnfoldErrors::CreatePlotsWithChi2()
 {
-    /*Gets the values for plotting. Uses the Runtoy method from RooUnfold to get plots to analyse for
-    spread and error on the unfolding. Can also give values for a chi squared plot if a truth distribution is known*/
+    /*Gets the values for plotting. Uses toys smeared like RooUnfold::RunToy to get the spread of
+    the unfolded results and the mean unfolding error in each bin, and the chi squared of each toy
+    with respect to the truth distribution. Only running sums are kept while the toys run.*/
 
     const Double_t maxchi2=1e10;
 
+    ULong64_t seed= unfold->ToySeed() ? unfold->ToySeed() : gRandom->Integer(kMaxUInt) + 1;
+    Int_t nthreads= unfold->ToyThreads (toys);
+
+    unfold->PrepareToys();
+    chi2val.assign (toys>0 ? toys : 0, 0.0);
+    TString name= unfold->GetName();
+    name += "_toy";
+    std::vector<RooUnfold*> toy (nthreads);
+    std::vector<RooUnfoldWelford> acc (nthreads, RooUnfoldWelford(ntx));
+    std::vector<TVectorD> errsum (nthreads, TVectorD(ntx)), errsum2 (nthreads, TVectorD(ntx));
+    for (Int_t t= 0; t<nthreads; t++) {
+      toy[t]= unfold->Clone(name);
+      toy[t]->SetMeasured (unfold->Vmeasured(), unfold->Emeasured());  // make the copy's measured histogram here, not in its thread
+    }
+    if (nthreads==1) {
+      RunToys (toy[0], 0, toys, seed, &acc[0], &errsum[0], &errsum2[0], &chi2val[0]);
+    } else {
+      std::vector<std::thread> threads;
+      for (Int_t t= 0; t<nthreads; t++)
+        threads.push_back (std::thread (&RooUnfoldErrors::RunToys, this, toy[t],
+                                        Int_t((Long64_t(t)*toys)/nthreads), Int_t((Long64_t(t+1)*toys)/nthreads),
+                                        seed, &acc[t], &errsum[t], &errsum2[t], &chi2val[0]));
+      for (Int_t t= 0; t<nthreads; t++) threads[t].join();
+    }
+    for (Int_t t= 0; t<nthreads; t++) {
+      if (t>0) {
+        acc[0].Add (acc[t]);
+        errsum[0]  += errsum[t];
+        errsum2[0] += errsum2[t];
+      }
+      delete toy[t];
+    }
+    mean.ResizeTo (ntx);
+    mean= acc[0].Mean();
+    acc[0].Covariance (cov);
+
     Bool_t oldstat= TH1::AddDirectoryStatus();
     TH1::AddDirectory (kFALSE);
+    h_err     = new TH1D ("unferr", "Unfolding errors", ntx, xlo, xhi); 
+    h_err_res = new TH1D ("toyerr", "Toy MC RMS",       ntx, xlo, xhi); 
+    TH1::AddDirectory (oldstat);
 
-    h_err     = new TProfile ("unferr", "Unfolding errors", ntx, xlo, xhi); 
-    h_err_res = new TH1D     ("toyerr", "Toy MC RMS",       ntx, xlo, xhi); 
-    hchi2     = new TNtuple  ("chi2", "chi2", "chi2");
-    std::vector<TH1D*> graph_vector(ntx);
-    for (int a=0; a<ntx; a++) {
-      TString graph_name;
-      graph_name.Form("resbin%d",a);
-      graph_vector[a]= new TH1D (graph_name,graph_name, 100,0,10000);
+    Double_t n= acc[0].Entries();
+    if (n>0.0) {
+      for (int i=0; i<ntx; i++){
+        Double_t e= errsum[0][i]/n;
+        Double_t evar= errsum2[0][i]/n - e*e;
+        h_err->SetBinContent (i+1, e);
+        h_err->SetBinError   (i+1, evar>0.0 ? sqrt(evar/n) : 0.0);
+        Double_t spr= sqrt(cov(i,i));
+        h_err_res->SetBinContent (i+1, spr);
+        h_err_res->SetBinError   (i+1, spr/sqrt(2*n));
+      }
     }
-    
-    TH1::AddDirectory (oldstat);
-    
+
     int odd_ch=0;
-    for (int k=0; k<toys;k++){  
-        RooUnfold* toy= unfold->RunToy();
-        Double_t chi2=       toy->Chi2 (hTrue);
-        const TVectorD reco= toy->Vreco();
-        const TVectorD err=  toy->ErecoV();
-        for (int i=0; i<ntx; i++) {    
-            graph_vector[i]->Fill(reco[i]);
-            h_err->Fill(h_err->GetBinCenter(i+1),err[i]);
-        } 
-        if (hTrue){
-            hchi2->Fill(chi2);
-            if (fabs(chi2)>=maxchi2 && toy->verbose()>=1){
-                cerr<<"Large |chi^2| value: "<< chi2 << endl;
-                odd_ch++;
-            }
+    for (size_t k=0; k<chi2val.size(); k++) {
+        if (fabs(chi2val[k])>=maxchi2){
+            if (unfold->verbose()>=1) cerr<<"Large |chi^2| value: "<< chi2val[k] << endl;
+            odd_ch++;
         }
-        delete toy;
     }
-    for (int i=0; i<ntx; i++){
-      TH1D* graph= graph_vector[i];
-        Double_t n= graph->GetEntries();
-        if (n<=0.0) continue;
-        Double_t spr= graph->GetRMS();
-        h_err_res->SetBinContent (i+1, spr);
-        h_err_res->SetBinError   (i+1, spr/sqrt(2*n));
-        delete graph;
-    }
-    
     if (odd_ch){
         cout <<"There are " << odd_ch << " bins over outside the range of 0 to "<<maxchi2 <<endl;
     }
 
 }
 
+void
+RooUnfoldErrors::RunToys (RooUnfold* toy, Int_t first, Int_t last, ULong64_t seed,
+                          RooUnfoldWelford* acc, TVectorD* errsum, TVectorD* errsum2, Float_t* chi2) const
+{
+    // Runs toys first..last-1, reusing toy. Toy k uses random number stream (seed,k).
+    RooUnfoldRandom rnd;
+    TVectorD newmeas (unfold->response()->GetNbinsMeasured());
+    for (Int_t k= first; k<last; k++) {
+        rnd.SetStream (seed, k);
+        unfold->SmearToy (toy, rnd, newmeas);
+        chi2[k]= toy->Chi2 (hTrue);
+        const TVectorD& reco= toy->Vreco();
+        if (reco.GetNrows()!=ntx) continue;
+        acc->Add (reco);
+        const TVectorD err= toy->ErecoV();
+        for (int i=0; i<ntx; i++) {
+            (*errsum) [i] += err[i];
+            (*errsum2)[i] += err[i]*err[i];
+        }
+    }
+}
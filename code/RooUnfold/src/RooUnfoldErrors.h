@@ -12,11 +12,16 @@
 #ifndef ROOUNFOLDERRORS_H_
 #define ROOUNFOLDERRORS_H_
 
+#include <vector>
+
 #include "TNamed.h"
+#include "TVectorD.h"
+#include "TMatrixD.h"
 
 class TH1;
 class RooUnfold;
 class TNtuple;
+class RooUnfoldWelford;
 
 class RooUnfoldErrors : public TNamed {
 
@@ -31,13 +36,21 @@ public:
 
   TH1* RMSResiduals();
   TH1* UnfoldingError();
+  const TVectorD& ToyMean() const;        // Mean of the toy results (with truth only)
+  const TMatrixD& ToyCovariance() const;  // Covariance of the toy results (with truth only)
+  Double_t Chi2Quantile (Double_t p) const; // Quantile p of the toy chi squared values
 
 private:
   void CreatePlots();
   void CreatePlotsWithChi2();
+  void RunToys (RooUnfold* toy, Int_t first, Int_t last, ULong64_t seed,
+                RooUnfoldWelford* acc, TVectorD* errsum, TVectorD* errsum2, Float_t* chi2) const;
   TH1* h_err; // Output plot
   TH1* h_err_res; // Output plot
-  TNtuple* hchi2;  // Output plot 
+  TNtuple* hchi2;  // Output plot, made from chi2val when first asked for
+  std::vector<Float_t> chi2val; // chi squared of each toy
+  TVectorD mean; // Mean of the toy results
+  TMatrixD cov;  // Covariance of the toy results
   void GraphParameters(); //
   double xlo; // Minimum x-axis value 
   double xhi; // Maximum x-axis value
@@ -48,4 +61,20 @@ public:
   ClassDef (RooUnfoldErrors, 0)  // Show unfolding errors
 };
 
+// Inline method definitions
+
+inline
+const TVectorD& RooUnfoldErrors::ToyMean() const
+{
+  // Mean of the toy results, only filled when a truth distribution is given
+  return mean;
+}
+
+inline
+const TMatrixD& RooUnfoldErrors::ToyCovariance() const
+{
+  // Covariance of the toy results, only filled when a truth distribution is given
+  return cov;
+}
+
 #endif
@@ -0,0 +1,146 @@
+//=====================================================================-*-C++-*-
+// File and Version Information:
+//      $Id$
+//
+// Description:
+//      Read-only view of histogram bin contents and errors by vector index.
+//
+//==============================================================================
+
+#ifndef ROOUNFOLDHISTVIEW_HH
+#define ROOUNFOLDHISTVIEW_HH
+
+#include <cmath>
+
+#include "TH1.h"
+#include "TH2.h"
+#include "TH3.h"
+#include "TArrayD.h"
+#include "TArrayF.h"
+
+class RooUnfoldHistView {
+  // Reads the bins of a histogram in the order used for RooUnfold vectors and matrices
+  // (see RooUnfoldResponse::GetBin), without copying them.
+  // For TH1D/TH2D/TH3D and TH1F/TH2F/TH3F the bin storage is read directly, otherwise
+  // (eg. profiles, or histograms with a fill buffer, whose entries may not be in the
+  // bins yet) through GetBinContent/GetBinError. The histogram must outlive the view
+  // and not be changed while it is used: copy the contents before modifying them.
+
+public:
+
+  RooUnfoldHistView (const TH1* h= 0, Bool_t overflow= kFALSE);
+
+  Int_t    Size() const;                         // number of vector elements: nx*ny*nz, +2 with overflow
+  Int_t    GetBin (Int_t i) const;               // vector index -> global bin number
+  Double_t operator[] (Int_t i) const;           // content of vector element i
+  Double_t Error      (Int_t i) const;           // error   of vector element i
+  Double_t operator() (Int_t i, Int_t j) const;  // content of 2D matrix element (x,y)=(i,j)
+  Double_t Error      (Int_t i, Int_t j) const;  // error   of 2D matrix element (x,y)=(i,j)
+  const TH1* Hist() const;
+
+private:
+
+  Double_t Content (Int_t bin) const;
+  Double_t BinError (Int_t bin) const;
+
+  const TH1*      _h;
+  const Double_t* _d;     // bin contents, if stored as doubles
+  const Float_t*  _f;     // bin contents, if stored as floats
+  const Double_t* _w2;    // sum of squares of weights, if stored
+  Bool_t          _poisson; // errors need GetBinError (non-default error option)
+  Int_t           _first; // global bin of vector element 0 for 1D, and of matrix element (0,0) for 2D
+  Int_t           _nx;    // x-axis stride of the global bin number
+  Int_t           _dim;
+  Int_t           _size;
+};
+
+// Inline method definitions
+
+inline
+RooUnfoldHistView::RooUnfoldHistView (const TH1* h, Bool_t overflow)
+  : _h(h), _d(0), _f(0), _w2(0), _poisson(kFALSE), _first(overflow ? 0 : 1), _nx(0), _dim(0), _size(0)
+{
+  if (!h) return;
+  _dim= h->GetDimension();
+  _nx= h->GetNbinsX()+2;
+  _size= h->GetNbinsX()*h->GetNbinsY()*h->GetNbinsZ();
+  if (overflow) _size += 2;
+  if (_dim>=2) _first= overflow ? 0 : _nx+1;
+  if (h->GetBuffer()) return;   // GetBinContent empties the buffer first
+  TClass* c= h->IsA();
+  if      (c==TH1D::Class() || c==TH2D::Class() || c==TH3D::Class()) _d= dynamic_cast<const TArrayD*>(h)->GetArray();
+  else if (c==TH1F::Class() || c==TH2F::Class() || c==TH3F::Class()) _f= dynamic_cast<const TArrayF*>(h)->GetArray();
+  else return;
+  if (h->GetSumw2N()) _w2= h->GetSumw2()->GetArray();
+  _poisson= (h->GetBinErrorOption() != TH1::kNormal);
+}
+
+inline
+Int_t RooUnfoldHistView::Size() const
+{
+  // Number of vector elements
+  return _size;
+}
+
+inline
+const TH1* RooUnfoldHistView::Hist() const
+{
+  // Histogram being viewed
+  return _h;
+}
+
+inline
+Int_t RooUnfoldHistView::GetBin (Int_t i) const
+{
+  // Vector index -> global bin number, as RooUnfoldResponse::GetBin
+  if (_dim<2) return i+_first;
+  Int_t nx= _h->GetNbinsX(), ny= _h->GetNbinsY();
+  if (_dim==2) return (i%nx+1) + _nx*(i/nx+1);
+  return (i%nx+1) + _nx*((i/nx)%ny+1 + (ny+2)*(i/(nx*ny)+1));
+}
+
+inline
+Double_t RooUnfoldHistView::Content (Int_t bin) const
+{
+  if (_d) return _d[bin];
+  if (_f) return _f[bin];
+  return _h->GetBinContent (bin);
+}
+
+inline
+Double_t RooUnfoldHistView::BinError (Int_t bin) const
+{
+  if (_poisson || !(_d || _f)) return _h->GetBinError (bin);
+  if (_w2) return sqrt (_w2[bin]);
+  return sqrt (fabs (Content (bin)));
+}
+
+inline
+Double_t RooUnfoldHistView::operator[] (Int_t i) const
+{
+  // Content of vector element i
+  return Content (GetBin (i));
+}
+
+inline
+Double_t RooUnfoldHistView::Error (Int_t i) const
+{
+  // Error of vector element i
+  return BinError (GetBin (i));
+}
+
+inline
+Double_t RooUnfoldHistView::operator() (Int_t i, Int_t j) const
+{
+  // Content of 2D histogram bin (i,j) counting from the first bin (or the underflow with overflow)
+  return Content (_first + i + _nx*j);
+}
+
+inline
+Double_t RooUnfoldHistView::Error (Int_t i, Int_t j) const
+{
+  // Error of 2D histogram bin (i,j) counting from the first bin (or the underflow with overflow)
+  return BinError (_first + i + _nx*j);
+}
+
+#endif
@@ -7,13 +7,20 @@
 #include "RooUnfoldIds.h"
 #include "RooUnfoldResponse.h"
 
+#include "RooUnfoldToys.h"
+#include "RooUnfoldHistView.h"
+
 #include <iostream>
+#include <vector>
+#include <thread>
 
 #include "TClass.h"
 #include "TBuffer.h"
 #include "TRandom3.h"
 #include "TMath.h"
 #include "TH2D.h"
+#include "TMatrixDSym.h"
+#include "TDecompChol.h"
 
 ClassImp(RooUnfoldIds)
 
@@ -61,18 +68,14 @@ RooUnfoldIds::Reset()
 void
 RooUnfoldIds::Destroy()
 {
-   delete _meas1d;
-   delete _train1d;
-   delete _truth1d;
-   delete _reshist;
+   _mMig.ResizeTo(0, 0);
 }
 
 //______________________________________________________________________________
 void
 RooUnfoldIds::Init()
 {
-   _meas1d = _train1d = _truth1d = 0;
-   _reshist = 0;
+   _nb = 0;
    GetSettings();
 }
 
@@ -99,7 +102,32 @@ RooUnfoldIds::CopyData(const RooUnfoldIds &rhs)
 void
 RooUnfoldIds::Unfold()
 {
-   // Data and MC reco/truth must have the same number of bins
+   if (!SetupInputs()) {
+      std::cout << "Bins of input histograms don't all match, exiting IDS unfolding." << std::endl;
+      return;
+   }
+
+   if (_verbose >= 1) std::cout << "IDS init " << _nb << " x " << _nb << std::endl;
+
+   // Perform IDS unfolding
+   TVectorD result(_nb);
+   GetIDSUnfoldedVector(_vReco, _vTruth, _mMig, _vData, _vDataErr, _niter, result);
+
+   _rec.ResizeTo(_nt);
+   for (Int_t i = 0; i < _nt; ++i) {
+     _rec[i] = result[i];
+   }
+
+   _unfolded = kTRUE;
+   _haveCov = kFALSE;
+}
+
+//______________________________________________________________________________
+Bool_t
+RooUnfoldIds::SetupInputs()
+{
+   // Make the inputs as vectors without overflows (unless _overflow), with a truth bin for fakes.
+   // Data and MC reco/truth must have the same number of bins as the response
    if (_res->FakeEntries()) {
       _nb = _nt+1;
       if (_nm>_nb) _nb = _nm;
@@ -107,50 +135,51 @@ RooUnfoldIds::Unfold()
       _nb = _nm > _nt ? _nm : _nt;
    }
 
-   Bool_t oldstat= TH1::AddDirectoryStatus();
-   TH1::AddDirectory (kFALSE);
-
-   _meas1d  = HistNoOverflow(_meas            , _overflow); // data
-   _train1d = HistNoOverflow(_res->Hmeasured(), _overflow); // reco
-   _truth1d = HistNoOverflow(_res->Htruth()   , _overflow); // true
-   _reshist = _res->HresponseNoOverflow();
-
-   Resize(_meas1d,  _nb);
-   Resize(_train1d, _nb);
-   Resize(_truth1d, _nb);
-   Resize(_reshist, _nb, _nb);
+   // Read the histograms in place: the vectors are the only copies, zero-padded to _nb bins
+   RooUnfoldHistView data (_meas, _overflow), reco (_res->Hmeasured(), _overflow), truth (_res->Htruth(), _overflow);
+   RooUnfoldHistView mig (_res->Hresponse(), _overflow);
+   if (data.Size() != _nm || reco.Size() != _nm || truth.Size() != _nt) return kFALSE;
+
+   _vData   .ResizeTo(_nb);  _vData   .Zero();
+   _vDataErr.ResizeTo(_nb);  _vDataErr.Zero();
+   _vReco   .ResizeTo(_nb);  _vReco   .Zero();
+   _vTruth  .ResizeTo(_nb);  _vTruth  .Zero();
+   _mMig    .ResizeTo(_nb, _nb);  _mMig   .Zero();
+   _mMigErr .ResizeTo(_nb, _nb);  _mMigErr.Zero();
+   for (Int_t i = 0; i < _nm; ++i) {
+      _vData[i]    = data[i];
+      _vDataErr[i] = data.Error(i);
+      _vReco[i]    = reco[i];
+   }
+   for (Int_t j = 0; j < _nt; ++j) _vTruth[j] = truth[j];
+   for (Int_t i = 0; i < _nm; ++i) {
+      for (Int_t j = 0; j < _nt; ++j) {
+         _mMig   (i, j) = mig(i, j);
+         _mMigErr(i, j) = mig.Error(i, j);
+      }
+   }
 
-   // Something about fakes here?
+   // Add a truth bin for fakes
    if (_res->FakeEntries()) {
       TVectorD fakes = _res->Vfakes();
       Double_t nfakes = fakes.Sum();
+      Bool_t sumw2 = _res->Hresponse()->GetSumw2N();
       if (_verbose >= 1) std::cout << "Add truth bin for " << nfakes << " fakes" << std::endl;
-      for (Int_t i = 0; i < _nm; ++i) _reshist->SetBinContent(i+1, _nt+1, fakes[i]);
-      _truth1d->SetBinContent(_nt+1, nfakes);
-   }
-
-   if (_verbose >= 1) std::cout << "IDS init " << _reshist->GetNbinsX() << " x " << _reshist->GetNbinsY() << std::endl;
-
-   // Perform IDS unfolding
-   TH1D *rechist = dynamic_cast<TH1D*>(GetIDSUnfoldedSpectrum(_train1d, _truth1d, _reshist, _meas1d, _niter));
-
-   _rec.ResizeTo(_nt);
-   for (Int_t i = 0; i < _nt; ++i) {
-     _rec[i] = rechist->GetBinContent(i+1);
+      for (Int_t i = 0; i < _nm; ++i) {
+         _mMig   (i, _nt) = fakes[i];
+         _mMigErr(i, _nt) = sumw2 ? 0.0 : sqrt(fabs(fakes[i]));
+      }
+      _vTruth[_nt] = nfakes;
    }
 
-   delete rechist;
-   TH1::AddDirectory(oldstat);
-
-   _unfolded = kTRUE;
-   _haveCov = kFALSE;
+   return kTRUE;
 }
 
 //______________________________________________________________________________
 void
 RooUnfoldIds::GetCov()
 {
-   if (!_meas1d) return;
+   if (_mMig.GetNrows() == 0) return;
 
    Bool_t oldstat = TH1::AddDirectoryStatus();
    TH1::AddDirectory(kFALSE);
@@ -192,94 +221,18 @@ RooUnfoldIds::GetUnfoldCovMatrix(const TH2D *cov, Int_t ntoys, Int_t seed)
    // "seed"   - seed for pseudo experiments
    // Note that this covariance matrix will contain effects of forced normalisation if spectrum is normalised to unit area.
 
-   _meas1d  = HistNoOverflow(_meas            , _overflow); // data
-   _train1d = HistNoOverflow(_res->Hmeasured(), _overflow); // reco
-   _truth1d = HistNoOverflow(_res->Htruth()   , _overflow); // true
-   _reshist = _res->HresponseNoOverflow();
-
-   TH1D* unfres = 0;
-   TH2D* unfcov = (TH2D*)_reshist->Clone("unfcovmat");
-   unfcov->SetTitle("Toy covariance matrix");
-   for (Int_t i = 1; i <= _nb; ++i)
-      for(Int_t j = 1; j <= _nb; ++j)
-         unfcov->SetBinContent(i, j, 0.);
-
-   // Code for generation of toys (taken from TSVDUnfold [took from RooResult] and modified)
-   // Calculate the elements of the upper-triangular matrix L that
-   // gives Lt*L = C, where Lt is the transpose of L (the "square-root method")
-   TMatrixD L(_nb, _nb); L *= 0;
-
-   for (Int_t iPar = 0; iPar < _nb; ++iPar) {
-
-      // Calculate the diagonal term first
-      L(iPar, iPar) = cov->GetBinContent(iPar+1, iPar+1);
-      for (Int_t k = 0; k < iPar; ++k) L(iPar, iPar) -= TMath::Power(L(k, iPar), 2);
-      if (L(iPar, iPar) > 0.0) L(iPar, iPar) = TMath::Sqrt(L(iPar,iPar));
-      else                     L(iPar, iPar) = 0.0;
-
-      // ...then the off-diagonal terms
-      for (Int_t jPar = iPar+1; jPar < _nb; ++jPar) {
-         L(iPar, jPar) = cov->GetBinContent(iPar+1, jPar+1);
-         for (Int_t k = 0; k < iPar; k++) L(iPar, jPar) -= L(k, iPar)*L(k, jPar);
-         if (L(iPar,iPar) != 0.) L(iPar, jPar) /= L(iPar, iPar);
-         else                    L(iPar, jPar) = 0;
-      }
-   }
-
-   // Remember it
-   TMatrixD *Lt = new TMatrixD(TMatrixD::kTransposed, L);
-   TRandom3 random(seed);
-
-   // Needed to build covariance matrix
-   TVectorD avgtoy(_nb);
-   TMatrixD toys(ntoys, _nb);
-   for (Int_t j = 0; j < _nb; ++j) {
-      avgtoy[j] = 0.0;
-      for (Int_t i = 0; i < ntoys; ++i) {
-         toys[i][j] = 0.0;
-      }
-   }
-
-   // Get the mean of the toys first
-   TH1D *toyhist = (TH1D*)_meas1d->Clone("toyhisto");
-   for (Int_t i = 0; i < ntoys; i++) {
+   if (_mMig.GetNrows() == 0 && !SetupInputs()) return 0;
 
-      // create a vector of unit Gaussian variables
-      TVectorD g(_nb);
-      for (Int_t k = 0; k < _nb; ++k) g(k) = random.Gaus(0.,1.);
+   TMatrixD covmat(_nb, _nb);
+   for (Int_t i = 0; i < _nb; ++i)
+      for (Int_t j = 0; j < _nb; ++j)
+         covmat(i, j) = cov->GetBinContent(i+1, j+1);
 
-      // Multiply this vector by Lt to introduce the appropriate correlations
-      g *= (*Lt);
-
-      // Add the mean value offsets and store the results
-      for (Int_t j = 1; j <= _nb; ++j) {
-         toyhist->SetBinContent(j, _meas1d->GetBinContent(j) + g(j-1));
-         toyhist->SetBinError(j, _meas1d->GetBinError(j));
-      }
-
-      // Perform IDS unfolding
-      unfres = dynamic_cast<TH1D*>(GetIDSUnfoldedSpectrum(_train1d, _truth1d, _reshist, toyhist, _niter));
-
-      for (Int_t j = 0; j < _nb; ++j) {
-         toys[i][j] = unfres->GetBinContent(j+1);
-         avgtoy[j] += unfres->GetBinContent(j+1)/ntoys;
-      }
+   // Toys are the measured spectrum plus Lt*g, with Lt*Lt^T = cov and g unit Gaussian variables
+   TMatrixD Lt;
+   GetCholeskyT(covmat, Lt);
 
-      delete unfres;
-
-   }
-   delete toyhist;
-   delete Lt;
-
-   for (Int_t i = 0; i < ntoys; ++i) {
-      for (Int_t j = 0; j < _nb; ++j) {
-         for (Int_t k = 0; k < _nb; ++k) {
-            unfcov->SetBinContent(j+1, k+1, unfcov->GetBinContent(j+1, k+1) + (toys[i][j] - avgtoy[j])*(toys[i][k] - avgtoy[k])/ntoys);
-         }
-      }
-   }
-
-   return unfcov;
+   return GetToyCovMatrix(&Lt, 0, ntoys, seed);
 }
 
 //______________________________________________________________________________
@@ -291,70 +244,84 @@ RooUnfoldIds::GetAdetCovMatrix(Int_t ntoys, Int_t seed)
    // "ntoys"  - number of pseudo experiments used for the propagation
    // "seed"   - seed for pseudo experiments
 
-   _meas1d  = HistNoOverflow(_meas            , _overflow); // data
-   _train1d = HistNoOverflow(_res->Hmeasured(), _overflow); // reco
-   _truth1d = HistNoOverflow(_res->Htruth()   , _overflow); // true
-   _reshist = _res->HresponseNoOverflow();
-
-   TH1D *unfres = 0;
-   TH2D *unfcov = (TH2D*)_reshist->Clone("unfcovmat");
-   unfcov->SetTitle("Toy covariance matrix");
-   for(Int_t i = 1; i <= _nb; ++i)
-      for(Int_t j = 1; j <= _nb; ++j)
-         unfcov->SetBinContent(i, j, 0.0);
-
-   //Now the toys for the detector response matrix
-   TRandom3 random(seed);
-
-   // Needed to build covariance matrix
-   TVectorD avgtoy(_nb);
-   TMatrixD toys(ntoys, _nb);
-   for (Int_t j = 0; j < _nb; ++j) {
-      avgtoy[j] = 0.0;
-      for (Int_t i = 0; i < ntoys; ++i) {
-         toys[i][j] = 0.0;
-      }
-   }
+   if (_mMig.GetNrows() == 0 && !SetupInputs()) return 0;
 
-   TH2D *toymat = (TH2D*)_reshist->Clone("toymat");
-   Double_t fluc = -1.0;
-   for (Int_t i = 0; i < ntoys; ++i) {
-      for (Int_t k = 1; k <= _nb; ++k) {
-         for (Int_t m = 1; m <= _nb; ++m) {
-            if (_reshist->GetBinContent(k, m)) {
-               // fToymat->SetBinContent(k, m, random.Poisson(fAdet->GetBinContent(k,m)));
-               fluc = -1.0;
-               while (fluc < 0.0) {
-                  fluc = random.Gaus(_reshist->GetBinContent(k, m), _reshist->GetBinError(k, m));
-               }
-               
-               toymat->SetBinContent(k, m, fluc);
-            }
-         }
-      }
+   return GetToyCovMatrix(0, &_mMigErr, ntoys, seed);
+}
 
-      // Perform IDS unfolding
-      unfres = dynamic_cast<TH1D*>(GetIDSUnfoldedSpectrum(_train1d, _truth1d, toymat, _meas1d, _niter));
+//______________________________________________________________________________
+TH2D*
+RooUnfoldIds::GetToyCovMatrix(const TMatrixD *covLt, const TMatrixD *migerr, Int_t ntoys, Int_t seed)
+{
+   // Covariance matrix of the unfolded spectrum from ntoys toys, which smear the measured spectrum
+   // with covLt or, if covLt=0, the response matrix with the errors migerr.
+   // The toys are shared between NThreads() threads, each with its own work space.
+   // Toy k uses random number stream (seed,k), so each toy is the same whatever the number of threads,
+   // and the covariance only changes by rounding, as the threads' running sums are merged in a different order.
+   // Only the running mean and covariance of the toys are kept, not the toys themselves.
+   Int_t nthreads = ToyThreads(ntoys, kFALSE);
+
+   std::vector<RooUnfoldWelford> acc(nthreads, RooUnfoldWelford(_nb));
+   if (nthreads == 1) {
+      RunIdsToys(covLt, migerr, 0, ntoys, seed, &acc[0]);
+   } else {
+      std::vector<std::thread> threads;
+      for (Int_t t = 0; t < nthreads; ++t)
+         threads.push_back(std::thread(&RooUnfoldIds::RunIdsToys, this, covLt, migerr,
+                                       Int_t((Long64_t(t)*ntoys)/nthreads), Int_t((Long64_t(t+1)*ntoys)/nthreads),
+                                       ULong64_t(seed), &acc[t]));
+      for (Int_t t = 0; t < nthreads; ++t) threads[t].join();
+   }
+   for (Int_t t = 1; t < nthreads; ++t) acc[0].Add(acc[t]);
 
-      for (Int_t j = 0; j < _nb; ++j) {
-         toys[i][j] = unfres->GetBinContent(j+1);
-         avgtoy[j] += unfres->GetBinContent(j+1)/ntoys;
-      }
+   TMatrixD toycov;
+   acc[0].Covariance(toycov);
 
-      delete unfres;
-   }
+   TH2D* unfcov = new TH2D("unfcovmat", "Toy covariance matrix", _nb, 0.0, _nb, _nb, 0.0, _nb);
+   for (Int_t i = 0; i < _nb; ++i)
+      for (Int_t j = 0; j < _nb; ++j)
+         unfcov->SetBinContent(i+1, j+1, toycov(i, j));
 
-   delete toymat;
+   return unfcov;
+}
 
-   for (Int_t i = 0; i < ntoys; ++i) {
-      for (Int_t j = 0; j < _nb; ++j) {
-         for (Int_t k = 0; k < _nb; ++k) {
-            unfcov->SetBinContent(j+1, k+1, unfcov->GetBinContent(j+1, k+1) + (toys[i][j] - avgtoy[j])*(toys[i][k] - avgtoy[k])/ntoys);
+//______________________________________________________________________________
+void
+RooUnfoldIds::RunIdsToys(const TMatrixD *covLt, const TMatrixD *migerr, Int_t first, Int_t last, ULong64_t seed, RooUnfoldWelford *acc)
+{
+   // Unfold toys first..last-1, see GetToyCovMatrix. The vectors and matrices here are the work space of one thread.
+   RooUnfoldRandom rnd;
+   TVectorD g(_nb), data(_vData), result(_nb);
+   TMatrixD mig(_mMig);
+   const Int_t nbsq = _nb*_nb;
+   for (Int_t k = first; k < last; ++k) {
+      rnd.SetStream(seed, k);
+      if (covLt) {
+         const Double_t *pL = covLt->GetMatrixArray();
+         for (Int_t i = 0; i < _nb; ++i) g[i] = rnd.Gaus(0., 1.);
+         for (Int_t i = 0; i < _nb; ++i) {
+            const Double_t *Li = pL + i*_nb;
+            Double_t x = _vData[i];
+            for (Int_t j = 0; j <= i; ++j) x += Li[j]*g[j];
+            data[i] = x;
+         }
+      } else {
+         const Double_t *pm = _mMig.GetMatrixArray(), *pe = migerr->GetMatrixArray();
+         Double_t *pt = mig.GetMatrixArray();
+         for (Int_t km = 0; km < nbsq; ++km) {
+            if (!pm[km]) continue;
+            Double_t fluc = -1.0;
+            while (fluc < 0.0) {
+               fluc = rnd.Gaus(pm[km], pe[km]);
+            }
+            pt[km] = fluc;
          }
       }
-   }
 
-   return unfcov;
+      // Perform IDS unfolding
+      GetIDSUnfoldedVector(_vReco, _vTruth, mig, data, _vDataErr, _niter, result);
+      acc->Add(result);
+   }
 }
 
 //______________________________________________________________________________
@@ -368,6 +335,37 @@ RooUnfoldIds::GetSettings()
 TH1*
 RooUnfoldIds::GetIDSUnfoldedSpectrum(const TH1 *h_RecoMC, const TH1 *h_TruthMC, const TH2 *h_2DSmear, const TH1 *h_RecoData, Int_t iter)
 {
+   TVectorD reco, truth, data, dataerror, result;
+   TMatrixD migmatrix;
+   if (!GetIDSInputs(h_RecoMC, h_TruthMC, h_2DSmear, h_RecoData, reco, truth, migmatrix, data, dataerror)) {
+      std::cout << "Bins of input histograms don't all match, exiting IDS unfolding and returning NULL." << std::endl;
+      return NULL;
+   }
+
+   GetIDSUnfoldedVector(reco, truth, migmatrix, data, dataerror, iter, result);
+
+   // Make 1-D or 2-D histogram
+   TH1 *h_DataUnfolded = (TH1*)h_RecoData->Clone("unfolded");
+   h_DataUnfolded->SetTitle("unfolded");
+   h_DataUnfolded->Reset();
+
+   Int_t i = 0;
+   for (Int_t by = 1; by <= h_RecoData->GetNbinsY(); ++by) {
+      for (Int_t bx = 1; bx <= h_RecoData->GetNbinsX(); ++bx) {
+         h_DataUnfolded->SetBinContent(bx, by, result[i++]);
+      }
+   }
+
+   // Return result
+   return h_DataUnfolded;
+}
+
+//______________________________________________________________________________
+Bool_t
+RooUnfoldIds::GetIDSInputs(const TH1 *h_RecoMC, const TH1 *h_TruthMC, const TH2 *h_2DSmear, const TH1 *h_RecoData,
+                           TVectorD &reco, TVectorD &truth, TMatrixD &mig, TVectorD &data, TVectorD &dataerror) const
+{
+   // Put inputs into vectors, and if necessary turn 2-D inputs into 1-D inputs
    Int_t nbinsx = h_RecoData->GetNbinsX();
    Int_t nbinsy = h_RecoData->GetNbinsY();
    Int_t nbins  = nbinsx*nbinsy;
@@ -376,40 +374,58 @@ RooUnfoldIds::GetIDSUnfoldedSpectrum(const TH1 *h_RecoMC, const TH1 *h_TruthMC,
    if (h_TruthMC->GetNbinsX() != nbinsx || h_TruthMC->GetNbinsY() != nbinsy ||
        h_RecoMC->GetNbinsX()  != nbinsx || h_RecoMC->GetNbinsY()  != nbinsy ||
        h_2DSmear->GetNbinsX() != nbins) {
-      std::cout << "Bins of input histograms don't all match, exiting IDS unfolding and returning NULL." << std::endl;
-      return NULL;
+      return kFALSE;
    }
 
-   // Put inputs into vectors, and if necessary turn 2-D inputs into 1-D inputs
-   TVectorD reco(nbins), truth(nbins);
-   TVectorD data(nbins), dataerror(nbins);
+   reco.ResizeTo(nbins);
+   truth.ResizeTo(nbins);
+   data.ResizeTo(nbins);
+   dataerror.ResizeTo(nbins);
    Int_t i = 0;
    for (Int_t by = 1; by <= nbinsy; ++by) { // loop over pt
       for (Int_t bx = 1; bx <= nbinsx; ++bx) { // loop over gap_size, for each pt value
-         reco[i]  = h_RecoMC->GetBinContent(bx, by);
-         truth[i] = h_TruthMC->GetBinContent(bx, by);
-         data[i]  = h_RecoData->GetBinContent(bx, by);
-         if (data[i] > 0.0) {
-            dataerror[i] = h_RecoData->GetBinError(bx, by);
-         } else {
-            dataerror[i] = 1.0;
-         }
+         reco[i]      = h_RecoMC->GetBinContent(bx, by);
+         truth[i]     = h_TruthMC->GetBinContent(bx, by);
+         data[i]      = h_RecoData->GetBinContent(bx, by);
+         dataerror[i] = h_RecoData->GetBinError(bx, by);
          i++;
       }
    }
 
-   // Make transfer matrix and project matched MC spectra
-   TMatrixD migmatrix(nbins, nbins);
+   // Transfer matrix
+   mig.ResizeTo(nbins, nbins);
+   for (Int_t i = 0; i < nbins; ++i) {
+      for (Int_t j = 0; j < nbins; ++j) {
+         mig(i, j) = h_2DSmear->GetBinContent(i+1, j+1);
+      }
+   }
+   return kTRUE;
+}
+
+//______________________________________________________________________________
+void
+RooUnfoldIds::GetIDSUnfoldedVector(const TVectorD &reco, const TVectorD &truth, const TMatrixD &mig, const TVectorD &data_, const TVectorD &dataerror_, Int_t iter, TVectorD &result)
+{
+   // IDS unfolding of data_ (with errors dataerror_) using the reco and truth MC and transfer matrix mig.
+   // Only uses its arguments and local work space, so can be called from several threads.
+   Int_t nbins = reco.GetNrows();
+   TVectorD data(data_), dataerror(nbins);
+   for (Int_t i = 0; i < nbins; ++i) {
+      dataerror[i] = data[i] > 0.0 ? dataerror_[i] : 1.0;
+   }
+
+   // Project matched MC spectra
    TVectorD recomatch(nbins);
    TVectorD truthmatch(nbins);
+   const Double_t *pmig = mig.GetMatrixArray();
    for (Int_t i = 0; i < nbins; ++i) {
-      recomatch[i] = 0.0;
-      truthmatch[i] = 0.0;
+      const Double_t *migi = pmig + i*nbins;
+      Double_t sum = 0.0;
       for (Int_t j = 0; j < nbins; ++j) {
-         recomatch[i]   += h_2DSmear->GetBinContent(i+1, j+1);
-         truthmatch[i]  += h_2DSmear->GetBinContent(j+1, i+1);
-         migmatrix[i][j] = h_2DSmear->GetBinContent(i+1, j+1);
+         sum           += migi[j];
+         truthmatch[j] += migi[j];
       }
+      recomatch[i] = sum;
    }
 
    // Apply matching inefficiency from reco MC to data
@@ -429,8 +445,9 @@ RooUnfoldIds::GetIDSUnfoldedSpectrum(const TH1 *h_RecoMC, const TH1 *h_TruthMC,
    // Double_t lambdaMmin = 0.0;
    // Double_t lambdaS = 0.;
 
-   TVectorD result0(nbins), result(nbins);
-   PerformIterations(data, dataerror, migmatrix, nbins,
+   TVectorD result0(nbins);
+   result.ResizeTo(nbins);
+   PerformIterations(data, dataerror, mig, nbins,
                      _lambdaL, iter, _lambdaUmin, _lambdaMmin, _lambdaS,
                      &result0, &result);
 
@@ -442,21 +459,6 @@ RooUnfoldIds::GetIDSUnfoldedSpectrum(const TH1 *h_RecoMC, const TH1 *h_TruthMC,
          result[i] = 0.0;
       }
    }
-
-   // Make 1-D or 2-D histogram
-   TH1 *h_DataUnfolded = (TH1*)h_RecoData->Clone("unfolded");
-   h_DataUnfolded->SetTitle("unfolded");
-   h_DataUnfolded->Reset();
-
-   i = 0;
-   for (Int_t by = 1; by <= nbinsy; ++by) {
-      for (Int_t bx = 1; bx <= nbinsx; ++bx) {
-         h_DataUnfolded->SetBinContent(bx, by, result[i++]);
-      }
-   }
-
-   // Return result
-   return h_DataUnfolded;
 }
 
 //______________________________________________________________________________
@@ -502,55 +504,58 @@ RooUnfoldIds::MCnormalizationCoeffIter(const TVectorD *vd, const TVectorD *errvd
 
 //______________________________________________________________________________
 void
-RooUnfoldIds::IdsUnfold( const TVectorD &b, const TVectorD &errb, const TMatrixD &A, const Int_t dim, const Double_t lambda, TVectorD *soustr_, TVectorD *unf)
+RooUnfoldIds::IdsUnfold( const TVectorD &b, const TVectorD &errb, const TMatrixD &A, const Int_t dim, const Double_t lambda, TVectorD *soustr_, TVectorD *unf, TVectorD &rowsum, TVectorD &colsum)
 {
-   // compute the mc true and reco spectra and normalize them
-   TVectorD reco_mcN(dim), true_mcN(dim);
+   // One IDS unfolding step with transfer matrix A.
+   // rowsum and colsum are work space for the mc reco and true spectra (row and column sums of A),
+   // which are found in one pass over A. prob(j|i) = A[i][j]/rowsum[i] is used directly, not stored.
+   const Double_t *pA = A.GetMatrixArray();
+   Double_t *prow = rowsum.GetMatrixArray(), *pcol = colsum.GetMatrixArray();
+   Double_t *pu = unf->GetMatrixArray();
+   const Double_t *ps = soustr_->GetMatrixArray();
+
+   // compute the mc true and reco spectra
    Double_t estNkd = 0., Nkd = 0. , Nmc = 0.;
+   for(Int_t j=0; j<dim; j++ ) pcol[j] = 0.;
    for(Int_t i=0; i<dim; i++ ){
-      reco_mcN[i] = 0.;
-      true_mcN[i] = 0.;
+      const Double_t *Ai = pA + i*dim;
+      Double_t si = 0.;
       for(Int_t j=0; j<dim; j++ ){
-         reco_mcN[i] += A[i][j];
-         true_mcN[i] += A[j][i];
+         si      += Ai[j];
+         pcol[j] += Ai[j];
       }
-      if(b[i] - (*soustr_)[i] >= 0.){
-         Nmc += reco_mcN[i];
-         estNkd += b[i] - (*soustr_)[i];
+      prow[i] = si;
+      if(b[i] - ps[i] >= 0.){
+         Nmc += si;
+         estNkd += b[i] - ps[i];
       }
    }
 
    // # known data
-   Nkd = MCnormalizationCoeffIter(&b, &errb, &reco_mcN, dim, estNkd, Nmc, soustr_ );
+   Nkd = MCnormalizationCoeffIter(&b, &errb, &rowsum, dim, estNkd, Nmc, soustr_ );
 
+   // normalize the mc spectra
+   const Double_t norm = Nkd/Nmc;
    for(Int_t i=0; i<dim; i++ ){
-      reco_mcN[i] *= Nkd/Nmc;
-      true_mcN[i] *= Nkd/Nmc;
-      (*unf)[i] = true_mcN[i] + (*soustr_)[i];
+      pu[i] = pcol[i]*norm + ps[i];
    }
 
-   // compute the prob(j|i) matrix
-   TMatrixD prob(dim, dim);
+   // add the difference between data and normalized mc reco, unfolded with prob(j|i)
    for(Int_t i=0; i<dim; i++){
-      Double_t si = 0.;
-      for(Int_t j=0; j<dim; j++){
-         si += A[i][j];
-      }
-      for(Int_t j=0; j<dim; j++){
-         if( si!=0. )
-            prob[i][j] = A[i][j]/si;
-         else
-            prob[i][j] = 0.;
-      }
-
-      if (reco_mcN[i] != 0.0 && (b[i] - (*soustr_)[i]) > 0.0 /*&&((*b)[i]>0.)*/) {
-         Double_t ef = Probability( fabs(b[i]-(*soustr_)[i]-reco_mcN[i]), sqrt( pow(errb[i],2) /* + Nkd/Nmc*fabs((*reco_mcN)[i]) */ ), lambda );
-         for(Int_t j=0; j<dim; j++){
-            (*unf)[j] += ef * prob[i][j]*(b[i]-(*soustr_)[i]-reco_mcN[i]);
+      const Double_t reco_mcN = prow[i]*norm;
+      const Double_t diff = b[i] - ps[i] - reco_mcN;
+      if (reco_mcN != 0.0 && (b[i] - ps[i]) > 0.0 /*&&((*b)[i]>0.)*/) {
+         Double_t ef = Probability( fabs(diff), fabs(errb[i]) /* + Nkd/Nmc*fabs((*reco_mcN)[i]) */, lambda );
+         if (prow[i] != 0.) {
+            const Double_t *Ai = pA + i*dim;
+            const Double_t f = ef*diff/prow[i];
+            for(Int_t j=0; j<dim; j++){
+               pu[j] += f*Ai[j];
+            }
          }
-         (*unf)[i] += (1-ef) * (b[i]-(*soustr_)[i]-reco_mcN[i]);
+         pu[i] += (1-ef) * diff;
       } else {
-         (*unf)[i] += b[i]-(*soustr_)[i]-reco_mcN[i];
+         pu[i] += diff;
       }
    }
 
@@ -558,105 +563,105 @@ RooUnfoldIds::IdsUnfold( const TVectorD &b, const TVectorD &errb, const TMatrixD
 
 //______________________________________________________________________________
 void
-RooUnfoldIds::ComputeSoustrTrue( const TMatrixD *A, const TVectorD *unfres, const TVectorD *unfresErr, Int_t N, TVectorD *soustr_, Double_t lambdaS )
+RooUnfoldIds::ComputeSoustrTrue( const TVectorD &true_mcT, const TVectorD *unfres, const TVectorD *unfresErr, Int_t N, TVectorD *soustr_, Double_t lambdaS, TVectorD &active )
 {
-
-   TVectorD *true_mcT = new TVectorD(N), *active = new TVectorD(N);
+   // true_mcT are the column sums of the original transfer matrix; active is work space.
    Double_t estNkd = 0., Nmc=0., NkUR=0.;
    for(Int_t j=0; j<N; j++){
 
-      (*active)[j] = 1.;
+      active[j] = 1.;
 
-      (*true_mcT)[j] = 0.;
-      for(Int_t i=0; i<N; i++){
-         (*true_mcT)[j] += ((*A)[i][j]);
-      }
       if((*unfres)[j] - (*soustr_)[j] >= 0.){
-         Nmc += (*true_mcT)[j];
+         Nmc += true_mcT[j];
          estNkd += (*unfres)[j] - (*soustr_)[j];
       }
-
-      if( ((*true_mcT)[j]) < 0.){
-         std::cout << "found problematic (*true_mcT)[j] " << (*true_mcT)[j] << " " << j << " " << (*unfres)[j] << std::endl;
-         exit(1);
-      }
    }
 
    for(Int_t k=0; k<2; k++){
-      NkUR = MCnormalizationCoeffIter( unfres, unfresErr, true_mcT, N, estNkd, Nmc, soustr_ );
+      NkUR = MCnormalizationCoeffIter( unfres, unfresErr, &true_mcT, N, estNkd, Nmc, soustr_ );
 
       for(Int_t j=0; j<N; j++){
-         if( ((*unfres)[j] - (*soustr_)[j]>0.) && ((*true_mcT)[j]!=0.) && ((*active)[j]>0.) ){
-            Double_t ef = Probability(fabs((*unfres)[j] /*- (*soustr_)[j]*/ -NkUR/Nmc*(*true_mcT)[j]), sqrt(pow((*unfresErr)[j],2) /* +pow(NkUR/Nmc,2)*fabs((*true_mcT)[j]) */ ), lambdaS);
-            ((*soustr_)[j]) /*+*/= (1-ef) * ( (*unfres)[j] /*- (*soustr_)[j]*/ - (*true_mcT)[j]/(Nmc/NkUR));
+         if( ((*unfres)[j] - (*soustr_)[j]>0.) && (true_mcT[j]!=0.) && (active[j]>0.) ){
+            Double_t ef = Probability(fabs((*unfres)[j] /*- (*soustr_)[j]*/ -NkUR/Nmc*true_mcT[j]), fabs((*unfresErr)[j]) /* +pow(NkUR/Nmc,2)*fabs(true_mcT[j]) */, lambdaS);
+            ((*soustr_)[j]) /*+*/= (1-ef) * ( (*unfres)[j] /*- (*soustr_)[j]*/ - true_mcT[j]/(Nmc/NkUR));
          }
          else{
-            ((*soustr_)[j]) /*+*/= (*unfres)[j] /*- (*soustr_)[j]*/ - (*true_mcT)[j]/(Nmc/NkUR);
-            (*active)[j] = -1.;
+            ((*soustr_)[j]) /*+*/= (*unfres)[j] /*- (*soustr_)[j]*/ - true_mcT[j]/(Nmc/NkUR);
+            active[j] = -1.;
          }
       }
       estNkd = NkUR;
    }
-
-   delete true_mcT; delete active;
 }
 
 //______________________________________________________________________________
 void
-RooUnfoldIds::ModifyMatrix( TMatrixD *Am, const TMatrixD *A, const TVectorD *unfres, const TVectorD *unfresErr, Int_t N, const Double_t lambdaM_, TVectorD *soustr_, const Double_t lambdaS_ )
+RooUnfoldIds::ModifyMatrix( TMatrixD *Am, const TMatrixD *A, const TVectorD &true_mcT, const TVectorD *unfres, const TVectorD *unfresErr, Int_t N, const Double_t lambdaM_, TVectorD *soustr_, const Double_t lambdaS_, TVectorD &work )
 {
-   ComputeSoustrTrue( A, unfres, unfresErr, N, soustr_, lambdaS_ );
+   // Am = A with each column j rescaled towards the unfolded result.
+   // true_mcT are the column sums of A; work is work space.
+   ComputeSoustrTrue( true_mcT, unfres, unfresErr, N, soustr_, lambdaS_, work );
 
-   TVectorD *true_mcT = new TVectorD(N);
    Double_t estNkd = 0., Nmc=0., NkUR=0.;
    for(Int_t j=0; j<N; j++){
-      (*true_mcT)[j] = 0.;
-      for(Int_t i=0; i<N; i++){
-         (*true_mcT)[j] += ((*A)[i][j]);
-         ((*Am)[i][j]) = ((*A)[i][j]);
-      }
       if((*unfres)[j] - (*soustr_)[j] >= 0.){
-         Nmc += (*true_mcT)[j];
+         Nmc += true_mcT[j];
          estNkd += (*unfres)[j] - (*soustr_)[j];
       }
-
-      if( ((*true_mcT)[j]) < 0.){
-         std::cout << "found problematic (*true_mcT)[j] " << (*true_mcT)[j] << " " << j << " " << (*unfres)[j] << std::endl;
-         exit(1);
-      }
    }
 
-   NkUR = MCnormalizationCoeffIter( unfres, unfresErr, true_mcT, N, estNkd, Nmc, soustr_ );
+   NkUR = MCnormalizationCoeffIter( unfres, unfresErr, &true_mcT, N, estNkd, Nmc, soustr_ );
 
+   // relative change of each column
+   Double_t *fac = work.GetMatrixArray();
    for(Int_t j=0; j<N; j++){
-      if( (*unfres)[j] - (*soustr_)[j]>0. && (*true_mcT)[j]!=0. ){
-         Double_t ef = Probability(fabs((*unfres)[j] - (*soustr_)[j] -NkUR/Nmc*(*true_mcT)[j]), sqrt(pow((*unfresErr)[j],2) /* +pow(NkUR/Nmc,2)*fabs((*true_mcT)[j]) */ ), lambdaM_);
-         for(Int_t i=0; i<N; i++){
-            ((*Am)[i][j]) += ef * ( ((*unfres)[j] - (*soustr_)[j])*(Nmc/NkUR) - (*true_mcT)[j]) * ((*A)[i][j])/((*true_mcT)[j]);
-         }
+      fac[j] = 0.;
+      if( (*unfres)[j] - (*soustr_)[j]>0. && true_mcT[j]!=0. ){
+         Double_t ef = Probability(fabs((*unfres)[j] - (*soustr_)[j] -NkUR/Nmc*true_mcT[j]), fabs((*unfresErr)[j]) /* +pow(NkUR/Nmc,2)*fabs(true_mcT[j]) */, lambdaM_);
+         fac[j] = ef * ( ((*unfres)[j] - (*soustr_)[j])*(Nmc/NkUR) - true_mcT[j]) / true_mcT[j];
       }
    }
 
-   delete true_mcT;
+   const Double_t *pA = A->GetMatrixArray();
+   Double_t *pAm = Am->GetMatrixArray();
+   for(Int_t i=0; i<N; i++){
+      const Double_t *Ai = pA + i*N;
+      Double_t *Ami = pAm + i*N;
+      for(Int_t j=0; j<N; j++){
+         Ami[j] = Ai[j] + fac[j]*Ai[j];
+      }
+   }
 }
 
 //______________________________________________________________________________
 void
 RooUnfoldIds::PerformIterations(const TVectorD &data, const TVectorD &dataErr, const TMatrixD &A_, const Int_t &N_, const Double_t lambdaL_, const Int_t NstepsOptMin_, const Double_t lambdaU_, const Double_t lambdaM_, const Double_t lambdaS_, TVectorD* unfres1IDS_, TVectorD* unfres2IDS_)
 {
-   TVectorD soustr(N_);
-   for (Int_t i = 0; i < N_; i++) soustr[i] = 0.;
+   // Work space for all the steps, and the mc true spectrum of A_, which does not change
+   TVectorD soustr(N_), rowsum(N_), colsum(N_), work(N_), true_mcT(N_);
+   TMatrixD Am_(N_, N_);
+
+   const Double_t *pA = A_.GetMatrixArray();
+   for (Int_t i = 0; i < N_; i++) {
+      const Double_t *Ai = pA + i*N_;
+      for (Int_t j = 0; j < N_; j++) true_mcT[j] += Ai[j];
+   }
+   for (Int_t j = 0; j < N_; j++) {
+      if (true_mcT[j] < 0.) {
+         std::cout << "found problematic (*true_mcT)[j] " << true_mcT[j] << " " << j << std::endl;
+         exit(1);
+      }
+   }
 
-   IdsUnfold(data, dataErr, A_, N_, lambdaL_, &soustr, unfres1IDS_); // 1 step
+   IdsUnfold(data, dataErr, A_, N_, lambdaL_, &soustr, unfres1IDS_, rowsum, colsum); // 1 step
    
    for (Int_t i = 0; i < N_; i++) (*unfres2IDS_)[i] = (*unfres1IDS_)[i];
 
-   TMatrixD Am_(N_, N_);
    for (Int_t k = 0; k < NstepsOptMin_; k++) {
-      ModifyMatrix(&Am_, &A_, unfres2IDS_, &dataErr, N_, lambdaM_, &soustr, lambdaS_);
+      ModifyMatrix(&Am_, &A_, true_mcT, unfres2IDS_, &dataErr, N_, lambdaM_, &soustr, lambdaS_, work);
 
       // UNFOLDING
-      IdsUnfold(data, dataErr, Am_, N_, lambdaU_, &soustr, unfres2IDS_); // full iterations
+      IdsUnfold(data, dataErr, Am_, N_, lambdaU_, &soustr, unfres2IDS_, rowsum, colsum); // full iterations
    }
 }
 
@@ -692,6 +697,55 @@ RooUnfoldIds::GetSqrtMatrix( const TMatrixD& covMat )
    return sqrtMat;
 }
 
+//______________________________________________________________________________
+TMatrixD&
+RooUnfoldIds::GetCholeskyT(const TMatrixD& cov, TMatrixD& Lt)
+{
+   // Lower triangular matrix Lt with Lt*Lt^T = cov, for correlated Gaussian random numbers.
+   // Bins without variance (eg. an empty fakes bin) are left out of the Cholesky decomposition.
+   const Int_t n = cov.GetNrows();
+   Lt.ResizeTo(n, n);
+   Lt.Zero();
+   std::vector<Int_t> idx;
+   for (Int_t i = 0; i < n; ++i) if (cov(i, i) > 0.0) idx.push_back(i);
+   const Int_t m = idx.size();
+   if (m == 0) return Lt;
+
+   TMatrixDSym sub(m);
+   for (Int_t a = 0; a < m; ++a)
+      for (Int_t b = 0; b < m; ++b)
+         sub(a, b) = cov(idx[a], idx[b]);
+   TDecompChol chol(sub);
+   if (chol.Decompose()) {
+      const TMatrixD& U = chol.GetU();   // sub = U^T*U
+      for (Int_t a = 0; a < m; ++a)
+         for (Int_t b = 0; b <= a; ++b)
+            Lt(idx[a], idx[b]) = U(b, a);
+      return Lt;
+   }
+
+   // Not positive definite: square-root method, dropping directions without variance
+   TMatrixD L(n, n);
+   for (Int_t iPar = 0; iPar < n; ++iPar) {
+
+      // Calculate the diagonal term first
+      L(iPar, iPar) = cov(iPar, iPar);
+      for (Int_t k = 0; k < iPar; ++k) L(iPar, iPar) -= L(k, iPar)*L(k, iPar);
+      if (L(iPar, iPar) > 0.0) L(iPar, iPar) = TMath::Sqrt(L(iPar,iPar));
+      else                     L(iPar, iPar) = 0.0;
+
+      // ...then the off-diagonal terms
+      for (Int_t jPar = iPar+1; jPar < n; ++jPar) {
+         L(iPar, jPar) = cov(iPar, jPar);
+         for (Int_t k = 0; k < iPar; k++) L(iPar, jPar) -= L(k, iPar)*L(k, jPar);
+         if (L(iPar,iPar) != 0.) L(iPar, jPar) /= L(iPar, iPar);
+         else                    L(iPar, jPar) = 0;
+      }
+   }
+   Lt.Transpose(L);
+   return Lt;
+}
+
 //______________________________________________________________________________
 void
 RooUnfoldIds::GenGaussRnd( TArrayD& v, const TMatrixD& sqrtMat, TRandom3& R )
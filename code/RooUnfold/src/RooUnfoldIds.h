@@ -9,7 +9,11 @@
 
 #include "RooUnfold.h"
 
+#include "TVectorD.h"
+#include "TMatrixD.h"
+
 class RooUnfoldResponse;
+class RooUnfoldWelford;
 class TH1;
 class TH1D;
 class TH2D;
@@ -64,16 +68,23 @@ private:
    void Init();
    void Destroy();
    void CopyData(const RooUnfoldIds &rhs);
+   Bool_t SetupInputs();
 
    TH1* GetIDSUnfoldedSpectrum(const TH1 *h_RecoMC, const TH1 *h_TruthMC, const TH2 *h_2DSmear, const TH1 *h_RecoData, Int_t iter);
+   Bool_t GetIDSInputs(const TH1 *h_RecoMC, const TH1 *h_TruthMC, const TH2 *h_2DSmear, const TH1 *h_RecoData,
+                       TVectorD &reco, TVectorD &truth, TMatrixD &mig, TVectorD &data, TVectorD &dataerror) const;
+   void GetIDSUnfoldedVector(const TVectorD &reco, const TVectorD &truth, const TMatrixD &mig, const TVectorD &data, const TVectorD &dataerror, Int_t iter, TVectorD &result);
+   TH2D* GetToyCovMatrix(const TMatrixD *covLt, const TMatrixD *migerr, Int_t ntoys, Int_t seed);
+   void RunIdsToys(const TMatrixD *covLt, const TMatrixD *migerr, Int_t first, Int_t last, ULong64_t seed, RooUnfoldWelford *acc);
    Double_t Probability(Double_t deviation, Double_t sigma, Double_t lambda);
    Double_t MCnormalizationCoeff(const TVectorD *vd, const TVectorD *errvd, const TVectorD *vRecmc, const Int_t dim, const Double_t estNknownd, const Double_t Nmc, const Double_t lambda, const TVectorD *soustr_ );
    Double_t MCnormalizationCoeffIter(const TVectorD *vd, const TVectorD *errvd, const TVectorD *vRecmc, const Int_t dim, const Double_t estNknownd, const Double_t Nmc, const TVectorD *soustr_, Double_t lambdaN = 0., Int_t NiterMax = 5, Int_t messAct = 1);
-   void IdsUnfold(const TVectorD &b, const TVectorD &errb, const TMatrixD &A, const Int_t dim, const Double_t lambda, TVectorD *soustr_, TVectorD *unf);
-   void ComputeSoustrTrue(const TMatrixD *A, const TVectorD *unfres, const TVectorD *unfresErr, Int_t N, TVectorD *soustr_, Double_t lambdaS);
-   void ModifyMatrix(TMatrixD *Am, const TMatrixD *A, const TVectorD *unfres, const TVectorD *unfresErr, Int_t N, const Double_t lambdaM_, TVectorD *soustr_, const Double_t lambdaS_);
+   void IdsUnfold(const TVectorD &b, const TVectorD &errb, const TMatrixD &A, const Int_t dim, const Double_t lambda, TVectorD *soustr_, TVectorD *unf, TVectorD &rowsum, TVectorD &colsum);
+   void ComputeSoustrTrue(const TVectorD &true_mcT, const TVectorD *unfres, const TVectorD *unfresErr, Int_t N, TVectorD *soustr_, Double_t lambdaS, TVectorD &active);
+   void ModifyMatrix(TMatrixD *Am, const TMatrixD *A, const TVectorD &true_mcT, const TVectorD *unfres, const TVectorD *unfresErr, Int_t N, const Double_t lambdaM_, TVectorD *soustr_, const Double_t lambdaS_, TVectorD &work);
    void PerformIterations(const TVectorD &data, const TVectorD &dataErr, const TMatrixD &A_, const Int_t &N_, Double_t lambdaL_, Int_t NstepsOptMin_, Double_t lambdaU_, Double_t lambdaM_, Double_t lambdaS_, TVectorD* unfres1IDS_, TVectorD* unfres2IDS_);
    TMatrixD* GetSqrtMatrix(const TMatrixD& covMat);
+   static TMatrixD& GetCholeskyT(const TMatrixD& cov, TMatrixD& Lt);
    void GenGaussRnd(TArrayD& v, const TMatrixD& sqrtMat, TRandom3& R);
 
 protected:
@@ -85,11 +96,11 @@ protected:
    Double_t _lambdaMmin; // regularize Modification of folding matrix
    Double_t _lambdaS; // regularize background Subtraction
 
-   TH1D *_meas1d, *_train1d, *_truth1d;
-   TH2D *_reshist;
+   TVectorD _vReco, _vTruth, _vData, _vDataErr; //! inputs as vectors: reco and truth MC, data and its errors
+   TMatrixD _mMig, _mMigErr;                    //! input migration matrix and its errors
 
 public:
-   ClassDef(RooUnfoldIds, 1)
+   ClassDef(RooUnfoldIds, 2)
 };
 
 // Inline method definitions
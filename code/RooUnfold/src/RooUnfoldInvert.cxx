@@ -16,6 +16,10 @@
 <p>The simplest method of unfolding works by simply inverting the response matrix.</p> 
 <p>This is not accurate for small matrices and produces inaccurate unfolded distributions.</p>
 <p>The inversion method is included largely to illustrate the necessity of a more effective method of unfolding</p>
+<p>The singular value decomposition of the response is calculated once, and shared by
+all unfolding objects that use the same response object with the same contents
+(eg. the copies used for the error matrix toys), so each further unfolding only costs
+a matrix-vector product. It is redone if the response object is filled again.</p>
 END_HTML */
 
 /////////////////////////////////////////////////////////////
@@ -23,6 +27,9 @@ END_HTML */
 #include "RooUnfoldInvert.h"
 
 #include <iostream>
+#include <map>
+#include <utility>
+#include <mutex>
 
 #include "TH1.h"
 #include "TH2.h"
@@ -36,12 +43,163 @@ using std::cout;
 using std::cerr;
 using std::endl;
 
+//____________________________________________________________
+
+class RooUnfoldInvertSolver {
+  // SVD of a response matrix. Decompositions of response objects are looked up by the object
+  // and its RooUnfoldResponse::Version(), and shared while any unfolding object uses them;
+  // those of toy response matrices belong to a single unfolding object.
+  // Once constructed, Solve() only reads the decomposition, so it can be used by several threads.
+  // The pseudo-inverse, only needed for the covariance, is made on first use.
+public:
+  typedef std::pair<const RooUnfoldResponse*,Int_t> Key;  // response object and its version
+
+  static RooUnfoldInvertSolver* Get (const RooUnfoldResponse* res, Int_t verbose);
+  static RooUnfoldInvertSolver* Get (const TMatrixD& resToy, Int_t verbose);
+  Bool_t Matches (const RooUnfoldResponse* res) const;
+  Bool_t Solve (const TVectorD& meas, TVectorD& rec) const;
+  const TMatrixD* PseudoInverse();
+  void Release();
+
+  TDecompSVD _svd;      // SVD of the response, or its transpose if there are more truth than measured bins
+  Bool_t     _ok;       // decomposition succeeded
+
+private:
+  RooUnfoldInvertSolver (const TMatrixD& res, const Key& key, Int_t verbose);
+  ~RooUnfoldInvertSolver() { delete _resinv; }
+
+  Key               _key;         // response this is the decomposition of, or (0,0) for a toy response matrix
+  Bool_t            _trans;       // _svd is the decomposition of the transposed response
+  TMatrixD          _u, _v;       // columns of the singular vectors used by Solve
+  TVectorD          _sinv;        // inverse singular values, 0 below the SVD tolerance
+  TMatrixD*         _resinv;      // pseudo-inverse of the response
+  std::mutex        _mutex;       // protects _resinv
+  Int_t             _refs;        // number of unfolding objects using this, protected by fgMutex
+
+  static std::map<Key,RooUnfoldInvertSolver*> fgSolvers;  // decompositions in use, by response
+  static std::mutex fgMutex;                               // protects fgSolvers and _refs
+};
+
+std::map<RooUnfoldInvertSolver::Key,RooUnfoldInvertSolver*> RooUnfoldInvertSolver::fgSolvers;
+std::mutex RooUnfoldInvertSolver::fgMutex;
+
+RooUnfoldInvertSolver* RooUnfoldInvertSolver::Get (const RooUnfoldResponse* res, Int_t verbose)
+{
+  // Decomposition of the response object's current contents, made if no other unfolding object is using one.
+  // The lock is held while decomposing, so threads unfolding with the same response only decompose it once.
+  std::lock_guard<std::mutex> lock (fgMutex);
+  Key key (res, res->Version());
+  std::map<Key,RooUnfoldInvertSolver*>::iterator it= fgSolvers.find (key);
+  if (it != fgSolvers.end()) {
+    it->second->_refs++;
+    return it->second;
+  }
+  RooUnfoldInvertSolver* solver= new RooUnfoldInvertSolver (res->Mresponse(), key, verbose);
+  fgSolvers[key]= solver;
+  return solver;
+}
+
+RooUnfoldInvertSolver* RooUnfoldInvertSolver::Get (const TMatrixD& resToy, Int_t verbose)
+{
+  // Decomposition of a toy response matrix, not shared
+  return new RooUnfoldInvertSolver (resToy, Key(), verbose);
+}
+
+Bool_t RooUnfoldInvertSolver::Matches (const RooUnfoldResponse* res) const
+{
+  // True if this is the decomposition of res's current contents
+  return _key.first && res==_key.first && res->Version()==_key.second;
+}
+
+void RooUnfoldInvertSolver::Release()
+{
+  // Drop a reference. The decomposition is deleted, and removed from the lookup, when no unfolding object uses it.
+  std::lock_guard<std::mutex> lock (fgMutex);
+  if (--_refs > 0) return;
+  if (_key.first) fgSolvers.erase (_key);
+  delete this;
+}
+
+RooUnfoldInvertSolver::RooUnfoldInvertSolver (const TMatrixD& res, const Key& key, Int_t verbose)
+  : _ok(false), _key(key), _trans(res.GetNcols() > res.GetNrows()), _resinv(0), _refs(1)
+{
+  if (_trans) {
+    TMatrixD resT (TMatrixD::kTransposed, res);
+    _svd.SetMatrix (resT);
+  } else
+    _svd.SetMatrix (res);
+  if (!_svd.Decompose()) {
+    cerr << "Response matrix decomposition failed" << endl;
+    return;
+  }
+  if (_svd.Condition()<0){
+    cerr <<"Warning: response matrix bad condition= "<<_svd.Condition()<<endl;
+  }
+  // Decomposed matrix A (nr x nc, nr>=nc) = U S V^T, with the same cut on small singular values as TDecompSVD::Solve.
+  // Response R = A gives R^+ = V S^-1 U^T; R = A^T gives R^+ = U S^-1 V^T.
+  const TVectorD& sig= _svd.GetSig();
+  Int_t nc= sig.GetNrows();
+  const TMatrixD& u= _svd.GetU();
+  _u.ResizeTo (u.GetNrows(), nc);
+  _u= u.GetSub (0, u.GetNrows()-1, 0, nc-1);
+  _v.ResizeTo (_svd.GetV());
+  _v= _svd.GetV();
+  _sinv.ResizeTo (nc);
+  Double_t threshold= nc>0 ? sig[0]*_svd.GetTol() : 0.0;
+  for (Int_t k= 0; k<nc; k++) _sinv[k]= sig[k] > threshold ? 1.0/sig[k] : 0.0;
+  _ok= true;
+  if (verbose>=2) cout << "Decomposed " << res.GetNrows() << "x" << res.GetNcols() << " response matrix" << endl;
+}
+
+Bool_t RooUnfoldInvertSolver::Solve (const TVectorD& meas, TVectorD& rec) const
+{
+  // rec = R^+ meas, using the stored decomposition only
+  if (!_ok) return false;
+  const TMatrixD& left=  _trans ? _v : _u;   // multiplies meas
+  const TMatrixD& right= _trans ? _u : _v;   // gives rec
+  Int_t nc= _sinv.GetNrows(), nl= left.GetNrows(), nr= right.GetNrows();
+  if (meas.GetNrows() != nl) return false;
+  TVectorD y (nc);
+  const Double_t* pl= left.GetMatrixArray();
+  const Double_t* pr= right.GetMatrixArray();
+  for (Int_t i= 0; i<nl; i++) {
+    Double_t mi= meas[i];
+    if (mi==0.0) continue;
+    const Double_t* li= pl + i*nc;
+    for (Int_t k= 0; k<nc; k++) y[k] += li[k]*mi;
+  }
+  for (Int_t k= 0; k<nc; k++) y[k] *= _sinv[k];
+  rec.ResizeTo (nr);
+  for (Int_t j= 0; j<nr; j++) {
+    const Double_t* rj= pr + j*nc;
+    Double_t x= 0.0;
+    for (Int_t k= 0; k<nc; k++) x += rj[k]*y[k];
+    rec[j]= x;
+  }
+  return true;
+}
+
+const TMatrixD* RooUnfoldInvertSolver::PseudoInverse()
+{
+  std::lock_guard<std::mutex> lock (_mutex);
+  if (_resinv || !_ok) return _resinv;
+  const TMatrixD& left=  _trans ? _v : _u;
+  const TMatrixD& right= _trans ? _u : _v;
+  TMatrixD rs (right);
+  for (Int_t i= 0; i<rs.GetNrows(); i++)
+    for (Int_t k= 0; k<rs.GetNcols(); k++) rs(i,k) *= _sinv[k];
+  _resinv= new TMatrixD (rs, TMatrixD::kMultTranspose, left);
+  return _resinv;
+}
+
+//____________________________________________________________
+
 ClassImp (RooUnfoldInvert);
 
 RooUnfoldInvert::RooUnfoldInvert (const RooUnfoldInvert& rhs)
   : RooUnfold (rhs)
 {
-  // Copy constructor.
+  // Copy constructor. The decomposition of the response is looked up again on the first unfold.
   Init();
 }
 
@@ -64,48 +222,65 @@ RooUnfoldInvert::Clone (const char* newname) const
 
 RooUnfoldInvert::~RooUnfoldInvert()
 {
-  delete _svd;
-  delete _resinv;
+  ReleaseSolver();
 }
 
 void
 RooUnfoldInvert::Init()
 {
-  _svd= 0;
-  _resinv= 0;
+  _solver= 0;
   GetSettings();
 }
 
 void
 RooUnfoldInvert::Reset()
 {
-  delete _svd;
-  delete _resinv;
+  ReleaseSolver();
   Init();
   RooUnfold::Reset();
 }
 
+void
+RooUnfoldInvert::ReleaseSolver()
+{
+  // Drop our reference to the decomposition. It is deleted when no other unfolding object uses it.
+  if (_solver) _solver->Release();
+  _solver= 0;
+}
+
 TDecompSVD*
 RooUnfoldInvert::Impl()
 {
-  return _svd;
+  return _solver ? &_solver->_svd : 0;
+}
+
+void
+RooUnfoldInvert::SetResponse (const RooUnfoldResponse* res)
+{
+  // Set response matrix for unfolding. The decomposition is redone on the next unfold.
+  ReleaseSolver();
+  RooUnfold::SetResponse (res);
+}
+
+Bool_t
+RooUnfoldInvert::SetResponseToy (const TMatrixD* mres)
+{
+  // Unfold with response matrix mres, eg. for a toy. The decomposition is redone on the next unfold.
+  ReleaseSolver();
+  UseResponseToy (mres);
+  return kTRUE;
 }
 
 void
 RooUnfoldInvert::Unfold()
 {
-  if (_nt>_nm) {
-    TMatrixD resT (TMatrixD::kTransposed, _res->Mresponse());
-    _svd= new TDecompSVD (resT);
-    delete _resinv; _resinv= 0;
-  } else
-    _svd= new TDecompSVD (_res->Mresponse());
-  if (_svd->Condition()<0){
-    cerr <<"Warning: response matrix bad condition= "<<_svd->Condition()<<endl;
-  }
+  // The decomposition only depends on the response, so is kept for subsequent measured distributions
+  // until the response object is filled again
+  if (_solver && !_resToy && !_solver->Matches (_res)) ReleaseSolver();
+  if (!_solver) _solver= _resToy ? RooUnfoldInvertSolver::Get (*_resToy, _verbose)
+                                 : RooUnfoldInvertSolver::Get (_res, _verbose);
 
-  _rec.ResizeTo(_nm);
-  _rec= Vmeasured();
+  TVectorD meas= Vmeasured();
 
   if (_res->FakeEntries()) {
     TVectorD fakes= _res->Vfakes();
@@ -113,18 +288,10 @@ RooUnfoldInvert::Unfold()
     if (fac!=0.0) fac=  Vmeasured().Sum() / fac;
     if (_verbose>=1) cout << "Subtract " << fac*fakes.Sum() << " fakes from measured distribution" << endl;
     fakes *= fac;
-    _rec -= fakes;
+    meas -= fakes;
   }
 
-  Bool_t ok;
-  if (_nt>_nm) {
-    ok= InvertResponse();
-    if (ok) _rec *= *_resinv;
-  } else
-    ok= _svd->Solve (_rec);
-
-  _rec.ResizeTo(_nt);
-  if (!ok) {
+  if (!_solver->Solve (meas, _rec)) {
     cerr << "Response matrix Solve failed" << endl;
     return;
   }
@@ -136,33 +303,13 @@ RooUnfoldInvert::Unfold()
 void
 RooUnfoldInvert::GetCov()
 {
-    if (!InvertResponse()) return;
+    const TMatrixD* resinv= _solver ? _solver->PseudoInverse() : 0;
+    if (!resinv) return;
     _cov.ResizeTo(_nt,_nt);
-    ABAT (*_resinv, GetMeasuredCov(), _cov);
+    ABAT (*resinv, GetMeasuredCov(), _cov);
     _haveCov= true;
 }
 
-Bool_t
-RooUnfoldInvert::InvertResponse()
-{
-    if (!_svd)   return false;
-    if (_resinv) return true;
-    if (_nt>_nm) _resinv= new TMatrixD(_nm,_nt);
-    else         _resinv= new TMatrixD(_nt,_nm);
-#if ROOT_VERSION_CODE >= ROOT_VERSION(5,13,4)  /* TDecompSVD::Invert() didn't have ok status before 5.13/04. */
-    Bool_t ok;
-    *_resinv=_svd->Invert(ok);
-    if (!ok) {
-      cerr << "response matrix inversion failed" << endl;
-      return false;
-    }
-#else
-    *_resinv=_svd->Invert();
-#endif
-    if (_nt>_nm) _resinv->T();
-    return true;
-}
-
 void
 RooUnfoldInvert::GetSettings(){
     _minparm=0;
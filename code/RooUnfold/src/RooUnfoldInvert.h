@@ -21,6 +21,7 @@ class TH1;
 class TH1D;
 class TH2D;
 class TDecompSVD;
+class RooUnfoldInvertSolver;
 
 class RooUnfoldInvert : public RooUnfold {
 
@@ -35,24 +36,27 @@ public:
   RooUnfoldInvert (const RooUnfoldResponse* res, const TH1* meas, const char* name=0, const char* title=0);
 
   virtual void Reset();
+  virtual void SetResponse (const RooUnfoldResponse* res);
+  virtual Bool_t SetResponseToy (const TMatrixD* mres);
+  using RooUnfold::SetResponse;
   TDecompSVD* Impl();
 
 protected:
   virtual void Unfold();
   virtual void GetCov();
   virtual void GetSettings();
+  virtual Bool_t ToysInThreads() const;
 
 private:
   void Init();
-  Bool_t InvertResponse();
+  void ReleaseSolver();
 
 protected:
   // instance variables
-  TDecompSVD* _svd;
-  TMatrixD*   _resinv;
+  RooUnfoldInvertSolver* _solver; //! decomposition of the response, shared with other objects using the same response
 
 public:
-  ClassDef (RooUnfoldInvert, 1)  // Unregularised unfolding
+  ClassDef (RooUnfoldInvert, 2)  // Unregularised unfolding
 };
 
 // Inline method definitions
@@ -89,4 +93,11 @@ RooUnfoldInvert& RooUnfoldInvert::operator= (const RooUnfoldInvert& rhs)
   return *this;
 }
 
+inline
+Bool_t RooUnfoldInvert::ToysInThreads() const
+{
+  // Copies share a read-only decomposition, looked up under a lock, so can unfold in separate threads
+  return kTRUE;
+}
+
 #endif /*ROOUNFOLDINVERT_H_*/
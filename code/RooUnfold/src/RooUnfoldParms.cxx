@@ -23,6 +23,16 @@
 <p>For each regularisaion parameter in the predefined range, the measured distribution is unfolded. For each unfolded distribution residuals are plotted and rms found for the 
 rms spread. The sum of the residuals over the whole distribution are calculated,divided by the number of bins and then rooted in order to 
 return an rms. The chi squared values are calculated using the chi2() method in RooUnfold.</p>
+<p>For RooUnfoldBayes, the measured distribution is only unfolded once, with the maximum number of iterations,
+and the results for fewer iterations are taken from the state kept after each iteration (RooUnfoldBayes::RestoreIteration).
+For RooUnfoldSvd, the same object is unfolded for each kreg, so the SVD decompositions are only done once.</p>
+<p>For RooUnfoldBayes and RooUnfoldInvert, the parameter values are shared between the unfolding object's
+NThreads() threads, each with its own copies of the unfolding object. Other algorithms use one thread.
+With SetRefine(n), and a truth distribution, the scan is repeated n times on a finer grid
+(nsub steps per previous step) between the neighbours of the parameter with the smallest chi squared.
+Integer parameters (number of iterations, kreg) are not refined below a step of 1.
+The results for all the parameters tried are returned as a table by GetScan(), and the best one by GetBestParm().
+The plots only show the starting grid.</p>
 
  END_HTML */
 ////////////////////////////////////////////////////////////////
@@ -33,12 +43,17 @@ return an rms. The chi squared values are calculated using the chi2() method in
 #include <iostream>
 #include <cmath>
 #include <vector>
+#include <algorithm>
+#include <thread>
 
 #include "TROOT.h"
 #include "TStyle.h"
 #include "TH1D.h"
 #include "TProfile.h"
+#include "TNtuple.h"
 #include "RooUnfold.h"
+#include "RooUnfoldBayes.h"
+#include "RooUnfoldSvd.h"
 #include "TRandom.h"
 #include "RooUnfoldResponse.h"
 #include "TLatex.h"
@@ -63,6 +78,10 @@ RooUnfoldParms::Init()
     hch2=0;
     hres=0;  
     hrms=0;
+    hscan=0;
+    _bestparm=0;
+    _nrefine=0;
+    _nsub=4;
     _done_math=0;
     _maxparm=unfold->GetMaxParm();
     _minparm=unfold->GetMinParm();
@@ -75,6 +94,7 @@ RooUnfoldParms::~RooUnfoldParms()
   delete hch2;
   delete hres;  
   delete hrms;
+  delete hscan;
 }
 
 TProfile*
@@ -118,6 +138,123 @@ RooUnfoldParms::GetRMSResiduals()
     return dynamic_cast<TH1D*>(hrms->Clone());
 }
 
+TNtuple*
+RooUnfoldParms::GetScan()
+{
+    /*Returns table of the results for each regularisation parameter tried, in increasing order:
+     parm, mean error, mean residual, rms residual, chi squared (-1 without truth)*/
+    if (!_done_math){DoMath();} 
+    return hscan;
+}
+
+Double_t
+RooUnfoldParms::GetBestParm()
+{
+    //Returns the regularisation parameter with the smallest chi squared. Requires a known truth distribution.
+    if (!_done_math){DoMath();} 
+    return _bestparm;
+}
+
+static void
+ScanRange (const RooUnfoldParms* p, RooUnfold** unf, Bool_t reuse, const vector<Double_t>* parms,
+           Int_t first, Int_t last, vector<vector<Double_t> >* results)
+{
+    // Unfold for parameters first..last-1. If reuse, all are done with unf[0], otherwise with unf[i] (deleted afterwards).
+    // Results for each parameter are: mean error, chi2 (-1 if no truth), then the residuals of the non-empty bins.
+    Int_t overflow=p->unfold->Overflow();
+    Int_t nt = p->unfold->response()->GetNbinsTruth();
+    if (overflow) nt += 2;
+    for (Int_t i=first; i<last; i++) {
+        Double_t k=(*parms)[i];
+        RooUnfold* u= reuse ? unf[0] : unf[i];
+        if (RooUnfoldBayes* bayes= dynamic_cast<RooUnfoldBayes*>(u)) {
+            if (!bayes->RestoreIteration(Int_t(k+0.5))) {
+                bayes->SetRegParm(k);
+                bayes->KeepIterations();
+            }
+        } else if (reuse)
+            u->SetRegParm(k);
+        vector<Double_t>& r= (*results)[i];
+        Double_t sq_err_tot=0;
+        TH1* hReco=u->Hreco(p->doerror);
+        for (Int_t j= 0; j < nt; j++)
+        {
+          sq_err_tot += RooUnfoldResponse::GetBinError (hReco, j, overflow);
+        }
+        r.push_back(sq_err_tot/nt);
+        r.push_back(-1.0);
+        if (p->hTrue)
+        {
+            for (Int_t j=0;j<nt;j++){
+                Int_t jb= RooUnfoldResponse::GetBin (hReco, j, overflow);
+                if (hReco->GetBinContent(jb)!=0.0 || (hReco->GetBinError(jb)>0.0)) 
+                    r.push_back(hReco->GetBinContent(jb) - p->hTrue->GetBinContent(jb));
+            }
+            r[1]=u->Chi2(p->hTrue,p->doerror);
+        }
+        delete hReco;
+        if (!reuse) delete u;
+    }
+}
+
+void
+RooUnfoldParms::Scan(const vector<Double_t>& parms, vector<vector<Double_t> >& results) const
+{
+    //Unfolds with each of the parameters in parms, sharing them between threads.
+    Int_t n= parms.size();
+    results.assign(n, vector<Double_t>());
+    if (n<=0) return;
+    Int_t nthreads= unfold->ToyThreads (n);
+
+    // Fill the response caches, which are shared by all the copies
+    const RooUnfoldResponse* res= unfold->response();
+    res->Mresponse();
+    res->Eresponse();
+    res->Vmeasured();
+    res->Vtruth();
+    res->Vfakes();
+    unfold->PrepareToys();
+
+    // Bayes: each thread unfolds once, with the most iterations it needs, and restores the others
+    // SVD: each thread reuses one copy, so its decompositions are only done once
+    // Others: one copy per parameter value
+    Bool_t reuse= dynamic_cast<const RooUnfoldBayes*>(unfold) || dynamic_cast<const RooUnfoldSvd*>(unfold);
+    ULong64_t seed= unfold->ToySeed() ? unfold->ToySeed() : gRandom->Integer(kMaxUInt) + 1;
+    vector<Int_t> lo(nthreads+1);
+    for (Int_t t= 0; t<=nthreads; t++) lo[t]= Int_t((Long64_t(t)*n)/nthreads);
+    vector<RooUnfold*> unf(n,(RooUnfold*)0);
+    for (Int_t t= 0; t<nthreads; t++) {
+        for (Int_t i= lo[t]; i<lo[t+1]; i++) {
+            if (reuse && i>lo[t]) break;
+            RooUnfold* u= unfold->Clone("unfold_scan");
+            u->SetToySeed(seed);
+            u->SetNThreads(1);
+            if (RooUnfoldBayes* bayes= dynamic_cast<RooUnfoldBayes*>(u)) {
+                bayes->SetRegParm(*std::max_element(parms.begin()+lo[t], parms.begin()+lo[t+1]));
+                bayes->KeepIterations();
+            } else if (!reuse)
+                u->SetRegParm(parms[i]);
+            unf[i]= u;
+        }
+    }
+
+    Bool_t oldstat= TH1::AddDirectoryStatus();
+    TH1::AddDirectory (kFALSE);
+    if (nthreads==1) {
+        ScanRange (this, &unf[0], reuse, &parms, 0, n, &results);
+    } else {
+        vector<std::thread> threads;
+        for (Int_t t= 0; t<nthreads; t++)
+            threads.push_back (std::thread (ScanRange, this, reuse ? &unf[lo[t]] : &unf[0], reuse,
+                                            &parms, lo[t], lo[t+1], &results));
+        for (Int_t t= 0; t<nthreads; t++) threads[t].join();
+    }
+    TH1::AddDirectory (oldstat);
+    if (reuse) {
+        for (Int_t t= 0; t<nthreads; t++) delete unf[lo[t]];
+    }
+}
+
 void
 RooUnfoldParms::DoMath()
 {
@@ -146,54 +283,20 @@ RooUnfoldParms::DoMath()
     }
     
     else{ 
-        vector<TH1D*> graph_vector;    
-        for(Double_t a = _minparm; a<=_maxparm; a+=_stepsizeparm) {
-        TString graph_title("Residuals at k= ");
-        graph_title+=a;
-        TH1D* graph_name = new TH1D (graph_title,graph_title, 200,0,1000);
-        graph_vector.push_back(graph_name);
-        }
-        Int_t gvl=0;
-        Int_t _overflow=unfold->Overflow();
-        Int_t nt = unfold->response()->GetNbinsTruth();
-        if (_overflow) nt += 2;
-    
-        for (Double_t k=_minparm;k<=_maxparm;k+=_stepsizeparm)
-        {   
-            RooUnfold* unf = unfold->Clone("unfold_toy");
-            unf->SetRegParm(k);
-            Double_t sq_err_tot=0;
-            TH1* hReco=unf->Hreco(doerror); 
-            for (Int_t i= 0; i < nt; i++)
-            {
-              sq_err_tot += RooUnfoldResponse::GetBinError (hReco, i, _overflow);
-            }
-            herr->Fill(k,sq_err_tot/nt);
-            if (hTrue)
-            {   
-                Double_t rsqt=0;    
-                Double_t res_tot=0;
-                for (int i=0;i<nt;i++){
-                    Int_t j= RooUnfoldResponse::GetBin (hReco, i, _overflow);
-                    if (hReco->GetBinContent(j)!=0.0 || (hReco->GetBinError(j)>0.0)) 
-                    {
-                        Double_t res=hReco->GetBinContent(j) - hTrue->GetBinContent(j);
-                        //cout <<"res="<<res<<endl;
-                        Double_t rsq=res*res;
-                        rsqt+=rsq;
-                        graph_vector[gvl]->Fill(res);
-                        res_tot+=res;
-                        hres->Fill(k,res);
-                    }
-                }
-                double chi2=unf->Chi2(hTrue,doerror);
-                if (chi2<=1e10){
-                    hch2->Fill(k,chi2);
-                }
-                
+        vector<Double_t> parms;
+        for (Double_t k=_minparm;k<=_maxparm;k+=_stepsizeparm) parms.push_back(k);
+        vector<vector<Double_t> > results;
+        Scan(parms, results);
+        Int_t ngrid= parms.size();
+
+        for (Int_t i=0; i<ngrid; i++) {
+            Double_t k=parms[i];
+            const vector<Double_t>& r= results[i];
+            herr->Fill(k,r[0]);
+            if (hTrue) {
+                for (size_t j=2; j<r.size(); j++) hres->Fill(k,r[j]);
+                if (r[1]<=1e10) hch2->Fill(k,r[1]);
             }
-            gvl++;
-            delete unf;
         }
         Double_t bn=_minparm;
         for (int i=0; i<hres->GetNbinsX(); i++){
@@ -201,8 +304,62 @@ RooUnfoldParms::DoMath()
             hrms->Fill(bn,spr);
             bn+=_stepsizeparm;
         }
-        for (unsigned int i=0; i<graph_vector.size(); i++){
-            delete graph_vector[i];
+
+        // Refine around the smallest chi2
+        Bool_t intparm= (_stepsizeparm==floor(_stepsizeparm) && _minparm==floor(_minparm));
+        Double_t step=_stepsizeparm;
+        for (Int_t pass=0; hTrue && pass<_nrefine && _nsub>1; pass++) {
+            Int_t best=-1;
+            for (Int_t i=0; i<Int_t(parms.size()); i++) {
+                Double_t c= results[i][1];
+                if (c>=0.0 && c<=1e10 && (best<0 || c<results[best][1])) best=i;
+            }
+            if (best<0) break;
+            Double_t newstep= step/_nsub;
+            if (intparm) newstep= floor(newstep);
+            if (newstep<=0.0 || newstep>=step) break;
+            Double_t lo= std::max(parms[best]-step, _minparm), hi= std::min(parms[best]+step, _maxparm);
+            vector<Double_t> fine;
+            for (Double_t k=lo; k<=hi+0.5*newstep; k+=newstep) {
+                Bool_t done=false;
+                for (size_t i=0; i<parms.size() && !done; i++) done= fabs(parms[i]-k) < 1e-3*newstep;
+                if (!done) fine.push_back(k);
+            }
+            step=newstep;
+            if (fine.empty()) continue;
+            if (unfold->verbose()>=1) cout << "Refine scan with step " << step << " from " << lo << " to " << hi << endl;
+            vector<vector<Double_t> > fineres;
+            Scan(fine, fineres);
+            parms.insert(parms.end(), fine.begin(), fine.end());
+            results.insert(results.end(), fineres.begin(), fineres.end());
+        }
+
+        // Table of all the points, in order of parameter
+        vector<Int_t> order(parms.size());
+        for (size_t i=0; i<order.size(); i++) order[i]=i;
+        for (size_t i=1; i<order.size(); i++)
+            for (size_t j=i; j>0 && parms[order[j]]<parms[order[j-1]]; j--) std::swap(order[j],order[j-1]);
+        hscan= new TNtuple("hscan","regparm scan","parm:err:res:rms:chi2");
+        hscan->SetDirectory(0);
+        Double_t bestchi2=-1;
+        for (size_t o=0; o<order.size(); o++) {
+            Int_t i=order[o];
+            const vector<Double_t>& r= results[i];
+            Double_t res_tot=0, rsqt=0;
+            Int_t nres= r.size()-2;
+            for (Int_t j=0; j<nres; j++) {
+                res_tot+=r[j+2];
+                rsqt+=r[j+2]*r[j+2];
+            }
+            if (nres>0) {
+                res_tot/=nres;
+                rsqt=sqrt(rsqt/nres);
+            }
+            hscan->Fill(parms[i],r[0],res_tot,rsqt,r[1]);
+            if (r[1]>=0.0 && r[1]<=1e10 && (bestchi2<0 || r[1]<bestchi2)) {
+                bestchi2=r[1];
+                _bestparm=parms[i];
+            }
         }
     }
     _done_math=true;
@@ -228,3 +385,11 @@ RooUnfoldParms::SetStepSizeParm(double size)
     //Sets step size.
     _stepsizeparm=size;
 }
+
+void
+RooUnfoldParms::SetRefine(Int_t nrefine, Int_t nsub)
+{
+    //Sets number of refinement passes around the chi squared minimum, each with nsub steps per previous step.
+    _nrefine=nrefine;
+    _nsub=nsub;
+}
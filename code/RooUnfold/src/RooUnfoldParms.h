@@ -12,12 +12,15 @@
 #ifndef ROOUNFOLDPARMS_H_
 #define ROOUNFOLDPARMS_H_
 
+#include <vector>
+
 #include "TNamed.h"
 #include "RooUnfold.h"
 
 class TH1;
 class RooUnfold;
 class TProfile;
+class TNtuple;
 
 class RooUnfoldParms : public TNamed {
     public:
@@ -27,12 +30,15 @@ class RooUnfoldParms : public TNamed {
     TProfile* GetRMSError();
     TProfile* GetMeanResiduals();
     TH1* GetRMSResiduals();
+    TNtuple* GetScan();      // Table of results: parm:err:res:rms:chi2, one row per parameter value
+    Double_t GetBestParm();  // Parameter value with the smallest chi2 (needs truth)
     const RooUnfold* unfold; // Input object from RooUnfold
     RooUnfold::ErrorTreatment doerror; // Set error calculation method
     const TH1* hTrue; // Truth Distribution
     void SetMinParm(double min);
     void SetMaxParm(double max);
     void SetStepSizeParm(double size);
+    void SetRefine(Int_t nrefine, Int_t nsub=4); // Refine the scan nrefine times around the chi2 minimum
     
     private:
     bool _done_math;
@@ -40,11 +46,16 @@ class RooUnfoldParms : public TNamed {
     TProfile* hch2; // Output plot
     TProfile* herr; // Output plot
     TProfile* hres; // Output plot
+    TNtuple* hscan; // Output table
+    Double_t _bestparm; // Parameter with the smallest chi2
     void DoMath();
     void Init();
+    void Scan(const std::vector<Double_t>& parms, std::vector<std::vector<Double_t> >& results) const;
     Double_t _maxparm; //Maximum parameter
     Double_t _minparm; //Minimum parameter
     Double_t _stepsizeparm; //Step size
+    Int_t _nrefine; //Number of refinement passes
+    Int_t _nsub; //Steps per old step in each refinement pass
 public:
     ClassDef (RooUnfoldParms, 0)  // Optimisation of unfolding regularisation parameter
 };
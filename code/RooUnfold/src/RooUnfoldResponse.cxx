@@ -26,6 +26,7 @@ END_HTML */
 #include <iostream>
 #include <assert.h>
 #include <cmath>
+#include <algorithm>
 
 #include "TClass.h"
 #include "TNamed.h"
@@ -38,9 +39,12 @@ END_HTML */
 #include "TF3.h"
 #include "TVectorD.h"
 #include "TMatrixD.h"
+#include "TMatrixDSparse.h"
 #include "TRandom.h"
 #include "TCollection.h"
 
+#include "RooUnfoldHistView.h"
+
 #if ROOT_VERSION_CODE >= ROOT_VERSION(5,18,0)
 #define HAVE_RooUnfoldFoldingFunction
 #endif
@@ -221,7 +225,7 @@ RooUnfoldResponse::Add (const RooUnfoldResponse& rhs)
   assert (_fak != 0 && rhs._fak != 0);
   assert (_tru != 0 && rhs._tru != 0);
   assert (_res != 0 && rhs._res != 0);
-  if (_cached) ClearCache();
+  ClearCache();   // also counts as a change (see Version)
   _mes->Add (rhs._mes);
   _fak->Add (rhs._fak);
   _tru->Add (rhs._tru);
@@ -257,6 +261,7 @@ RooUnfoldResponse&
 RooUnfoldResponse::Init()
 {
   _overflow= 0;
+  _version= 0;
   return Setup();
 }
 
@@ -267,8 +272,11 @@ RooUnfoldResponse::Setup()
   _res= 0;
   _vMes= _eMes= _vFak= _vTru= _eTru= 0;
   _mRes= _eRes= 0;
+  _mResSparse= 0;
   _nm= _nt= _mdim= _tdim= 0;
-  _cached= false;
+  _cached= _dirty= false;
+  _dirtyMes.clear();
+  _dirtyTru.clear();
   return *this;
 }
 
@@ -459,7 +467,94 @@ RooUnfoldResponse::ClearCache()
   delete _eTru; _eTru= 0;
   delete _mRes; _mRes= 0;
   delete _eRes; _eRes= 0;
-  _cached= false;
+  delete _mResSparse; _mResSparse= 0;
+  _cached= _dirty= false;
+  _dirtyMes.clear();
+  _dirtyTru.clear();
+  _version++;
+}
+
+static void CompactDirty (std::vector<Int_t>& list)
+{
+  // Remove duplicate entries from a list of changed vector elements
+  std::sort (list.begin(), list.end());
+  list.erase (std::unique (list.begin(), list.end()), list.end());
+}
+
+void
+RooUnfoldResponse::Touch (Int_t im, Int_t it)
+{
+  // Records the measured and truth vector elements changed by a fill (-1 for none), so
+  // the next accessor only has to recompute those. Instead of keeping a flag per bin,
+  // the lists are compacted whenever they grow to twice the number of bins.
+  Int_t nm= _nm, nt= _nt;
+  if (_overflow) {
+    nm += 2;
+    nt += 2;
+  }
+  if (im >= 0 && im < nm) {
+    _dirtyMes.push_back (im);
+    if (Int_t(_dirtyMes.size()) > 2*nm) CompactDirty (_dirtyMes);
+    _dirty= true;
+  }
+  if (it >= 0 && it < nt) {
+    _dirtyTru.push_back (it);
+    if (Int_t(_dirtyTru.size()) > 2*nt) CompactDirty (_dirtyTru);
+    _dirty= true;
+  }
+}
+
+void
+RooUnfoldResponse::UpdateCache() const
+{
+  // Brings the cached vectors and matrices up to date after Fill, Miss, or Fake.
+  // Filling a truth bin changes the normalisation of that whole column of the response matrix,
+  // but no other column, so this costs O(nm) per truth bin filled, rather than O(nm*nt) to
+  // remake the matrix. The sparse matrix is not updated in place, but remade when next needed.
+  Int_t nm= _nm, nt= _nt;
+  if (_overflow) {
+    nm += 2;
+    nt += 2;
+  }
+  if (!_dirtyMes.empty()) {
+    CompactDirty (_dirtyMes);
+    RooUnfoldHistView mv (_mes, _overflow), fv (_fak, _overflow);
+    for (size_t k= 0; k < _dirtyMes.size(); k++) {
+      Int_t i= _dirtyMes[k];
+      if (_vMes)         (*_vMes)[i]= mv[i];
+      if (_eMes)         (*_eMes)[i]= mv.Error(i);
+      if (_vFak && _fak) (*_vFak)[i]= fv[i];
+    }
+    _dirtyMes.clear();
+  }
+  if (!_dirtyTru.empty()) {
+    CompactDirty (_dirtyTru);
+    RooUnfoldHistView tv (_tru, _overflow), rv (_res, _overflow);
+    Double_t* pm= _mRes ? _mRes->GetMatrixArray() : 0;
+    Double_t* pe= _eRes ? _eRes->GetMatrixArray() : 0;
+    for (size_t k= 0; k < _dirtyTru.size(); k++) {
+      Int_t j= _dirtyTru[k];
+      Double_t f= tv[j];
+      if (_vTru) (*_vTru)[j]= f;
+      if (_eTru) (*_eTru)[j]= tv.Error(j);
+      f= f != 0.0 ? 1.0/f : 0.0;
+      if (pm) for (Int_t i= 0; i < nm; i++) pm[i*nt+j]= rv(i,j)       * f;
+      if (pe) for (Int_t i= 0; i < nm; i++) pe[i*nt+j]= rv.Error(i,j) * f;
+    }
+    delete _mResSparse; _mResSparse= 0;
+    _dirtyTru.clear();
+  }
+  _dirty= false;
+}
+
+Int_t
+RooUnfoldResponse::CacheIndex (const TH1* h, Double_t x) const
+{
+  // Vector index of the 1D bin containing x, or -1 for an under/overflow without UseOverflow
+  Int_t bin= h->GetXaxis()->FindFixBin (x);
+  if (_overflow) return bin;
+  if (bin < 1 || bin > h->GetNbinsX()) return -1;
+  return bin-1;
 }
 
 Int_t
@@ -468,7 +563,8 @@ RooUnfoldResponse::Fill (Double_t xr, Double_t xt, Double_t w)
   // Fill 1D Response Matrix
   assert (_mes != 0 && _tru != 0);
   assert (_mdim==1 && _tdim==1);
-  if (_cached) ClearCache();
+  _version++;
+  if (_cached) Touch (CacheIndex (_mes, xr), CacheIndex (_tru, xt));
   _mes->Fill (xr, w);
   _tru->Fill (xt, w);
   return _res->Fill (xr, xt, w);
@@ -480,11 +576,13 @@ RooUnfoldResponse::Fill (Double_t xr, Double_t yr, Double_t xt, Double_t yt, Dou
   // Fill 2D Response Matrix
   assert (_mes != 0 && _tru != 0);
   assert (_mdim==2 && _tdim==2);
-  if (_cached) ClearCache();
+  Int_t im= FindBin (_mes, xr, yr), it= FindBin (_tru, xt, yt);
+  _version++;
+  if (_cached) Touch (im, it);
   ((TH2*)_mes)->Fill (xr, yr, w);
   ((TH2*)_tru)->Fill (xt, yt, w);
-  return _res->Fill (_res->GetXaxis()->GetBinCenter (FindBin (_mes, xr, yr)+1),
-                     _res->GetYaxis()->GetBinCenter (FindBin (_tru, xt, yt)+1), w);
+  return _res->Fill (_res->GetXaxis()->GetBinCenter (im+1),
+                     _res->GetYaxis()->GetBinCenter (it+1), w);
 }
 
 Int_t
@@ -493,11 +591,13 @@ RooUnfoldResponse::Fill (Double_t xr, Double_t yr, Double_t zr, Double_t xt, Dou
   // Fill 3D Response Matrix
   assert (_mes != 0 && _tru != 0);
   assert (_mdim==3 && _tdim==3);
-  if (_cached) ClearCache();
+  Int_t im= FindBin (_mes, xr, yr, zr), it= FindBin (_tru, xt, yt, zt);
+  _version++;
+  if (_cached) Touch (im, it);
   ((TH3*)_mes)->Fill (xr, yr, zr, w);
   ((TH3*)_tru)->Fill (xt, yt, zt, w);
-  return _res->Fill (_res->GetXaxis()->GetBinCenter (FindBin (_mes, xr, yr, zr)+1),
-                     _res->GetYaxis()->GetBinCenter (FindBin (_tru, xt, yt, zt)+1), w);
+  return _res->Fill (_res->GetXaxis()->GetBinCenter (im+1),
+                     _res->GetYaxis()->GetBinCenter (it+1), w);
 }
 
 Int_t
@@ -557,7 +657,8 @@ RooUnfoldResponse::Miss1D (Double_t xt, Double_t w)
   // Fill missed event (not reconstructed due to detection inefficiencies) into 1D Response Matrix (with weight)
   assert (_tru != 0);
   assert (_tdim==1);
-  if (_cached) ClearCache();
+  _version++;
+  if (_cached) Touch (-1, CacheIndex (_tru, xt));
   return _tru->Fill (xt, w);
 }
 
@@ -567,7 +668,8 @@ RooUnfoldResponse::Miss2D (Double_t xt, Double_t yt, Double_t w)
   // Fill missed event (not reconstructed due to detection inefficiencies) into 2D Response Matrix (with weight)
   assert (_tru != 0);
   assert (_tdim==2);
-  if (_cached) ClearCache();
+  _version++;
+  if (_cached) Touch (-1, FindBin (_tru, xt, yt));
   return ((TH2*)_tru)->Fill (xt, yt, w);
 }
 
@@ -577,7 +679,8 @@ RooUnfoldResponse::Miss (Double_t xt, Double_t yt, Double_t zt, Double_t w)
   // Fill missed event (not reconstructed due to detection inefficiencies) into 3D Response Matrix
   assert (_tru != 0);
   assert (_tdim==3);
-  if (_cached) ClearCache();
+  _version++;
+  if (_cached) Touch (-1, FindBin (_tru, xt, yt, zt));
   return ((TH3*)_tru)->Fill (xt, yt, zt, w);
 }
 
@@ -587,7 +690,8 @@ RooUnfoldResponse::Fake1D (Double_t xr, Double_t w)
   // Fill fake event (reconstructed event with no truth) into 1D Response Matrix (with weight)
   assert (_fak != 0 && _mes != 0);
   assert (_mdim==1);
-  if (_cached) ClearCache();
+  _version++;
+  if (_cached) Touch (CacheIndex (_mes, xr), -1);
          _mes->Fill (xr, w);
   return _fak->Fill (xr, w);
 }
@@ -598,7 +702,8 @@ RooUnfoldResponse::Fake2D (Double_t xr, Double_t yr, Double_t w)
   // Fill fake event (reconstructed event with no truth) into 2D Response Matrix (with weight)
   assert (_mes != 0);
   assert (_mdim==2);
-  if (_cached) ClearCache();
+  _version++;
+  if (_cached) Touch (FindBin (_mes, xr, yr), -1);
          ((TH2*)_fak)->Fill (xr, yr, w);
   return ((TH2*)_mes)->Fill (xr, yr, w);
 }
@@ -609,7 +714,8 @@ RooUnfoldResponse::Fake (Double_t xr, Double_t yr, Double_t zr, Double_t w)
   // Fill fake event (reconstructed event with no truth) into 3D Response Matrix
   assert (_mes != 0);
   assert (_mdim==3);
-  if (_cached) ClearCache();
+  _version++;
+  if (_cached) Touch (FindBin (_mes, xr, yr, zr), -1);
          ((TH3*)_mes)->Fill (xr, yr, zr, w);
   return ((TH3*)_fak)->Fill (xr, yr, zr, w);
 }
@@ -675,12 +781,24 @@ TVectorD*
 RooUnfoldResponse::H2V  (const TH1* h, Int_t nb, Bool_t overflow)
 {
   // Returns TVectorD of the bin contents of the input histogram
+  TVectorD* v= new TVectorD;
+  H2V (h, nb, *v, overflow);
+  return v;
+}
+
+TVectorD&
+RooUnfoldResponse::H2V  (const TH1* h, Int_t nb, TVectorD& v, Bool_t overflow)
+{
+  // Fills v with the bin contents of the input histogram, reusing its storage if it is the right size
   if (overflow) nb += 2;
-  TVectorD* v= new TVectorD (nb);
-  if (!h) return v;
-  for (Int_t i= 0; i < nb; i++) {
-    (*v)(i)= GetBinContent (h, i, overflow);
+  v.ResizeTo (nb);
+  if (!h) {
+    v.Zero();
+    return v;
   }
+  RooUnfoldHistView hv (h, overflow);
+  Double_t* pv= v.GetMatrixArray();
+  for (Int_t i= 0; i < nb; i++) pv[i]= hv[i];
   return v;
 }
 
@@ -700,12 +818,24 @@ TVectorD*
 RooUnfoldResponse::H2VE (const TH1* h, Int_t nb, Bool_t overflow)
 {
   // Returns TVectorD of bin errors for input histogram
+  TVectorD* v= new TVectorD;
+  H2VE (h, nb, *v, overflow);
+  return v;
+}
+
+TVectorD&
+RooUnfoldResponse::H2VE (const TH1* h, Int_t nb, TVectorD& v, Bool_t overflow)
+{
+  // Fills v with the bin errors of the input histogram, reusing its storage if it is the right size
   if (overflow) nb += 2;
-  TVectorD* v= new TVectorD (nb);
-  if (!h) return v;
-  for (Int_t i= 0; i < nb; i++) {
-    (*v)(i)= GetBinError (h, i, overflow);
+  v.ResizeTo (nb);
+  if (!h) {
+    v.Zero();
+    return v;
   }
+  RooUnfoldHistView hv (h, overflow);
+  Double_t* pv= v.GetMatrixArray();
+  for (Int_t i= 0; i < nb; i++) pv[i]= hv.Error(i);
   return v;
 }
 
@@ -713,51 +843,109 @@ TMatrixD*
 RooUnfoldResponse::H2M  (const TH2* h, Int_t nx, Int_t ny, const TH1* norm, Bool_t overflow)
 {
   // Returns Matrix of values of bins in a 2D input histogram
-  Int_t first= overflow ? 0 : 1;
+  TMatrixD* m= new TMatrixD;
+  H2M (h, nx, ny, *m, norm, overflow, kFALSE);
+  return m;
+}
+
+TMatrixD*
+RooUnfoldResponse::H2ME (const TH2* h, Int_t nx, Int_t ny, const TH1* norm, Bool_t overflow)
+{
+  // Returns matrix of bin errors for a 2D histogram.
+  // Assume Poisson norm, Multinomial P(mes|tru)
+  TMatrixD* m= new TMatrixD;
+  H2M (h, nx, ny, *m, norm, overflow, kTRUE);
+  return m;
+}
+
+TMatrixD&
+RooUnfoldResponse::H2M  (const TH2* h, Int_t nx, Int_t ny, TMatrixD& m, const TH1* norm, Bool_t overflow, Bool_t errors)
+{
+  // Fills m with the bin contents (or errors) of a 2D histogram, each column divided by the norm bin,
+  // reusing its storage if it is the right size
   if (overflow) {
     nx += 2;
     ny += 2;
   }
-  TMatrixD* m= new TMatrixD (nx, ny);
-  if (!h) return m;
-  for (Int_t j= 0; j < ny; j++) {
-    Double_t fac;
-    if (!norm) fac= 1.0;
-    else {
-      fac= GetBinContent (norm, j, overflow);
-      if (fac != 0.0) fac= 1.0/fac;
-    }
-    for (Int_t i= 0; i < nx; i++) {
-      (*m)(i,j)= h->GetBinContent(i+first,j+first) * fac;
+  m.ResizeTo (nx, ny);
+  if (!h) {
+    m.Zero();
+    return m;
+  }
+  RooUnfoldHistView hv (h, overflow), nv (norm, overflow);
+  std::vector<Double_t> fac (ny, 1.0);
+  if (norm) {
+    for (Int_t j= 0; j < ny; j++) {
+      Double_t f= nv[j];
+      fac[j]= f != 0.0 ? 1.0/f : f;
     }
   }
+  Double_t* pm= m.GetMatrixArray();
+  for (Int_t i= 0; i < nx; i++) {
+    Double_t* mi= pm + i*ny;
+    if (errors) for (Int_t j= 0; j < ny; j++) mi[j]= hv.Error(i,j) * fac[j];
+    else        for (Int_t j= 0; j < ny; j++) mi[j]= hv(i,j)       * fac[j];
+  }
   return m;
 }
 
-TMatrixD*
-RooUnfoldResponse::H2ME (const TH2* h, Int_t nx, Int_t ny, const TH1* norm, Bool_t overflow)
+TMatrixDSparse*
+RooUnfoldResponse::H2MS (const TH2* h, Int_t nx, Int_t ny, const TH1* norm, Bool_t overflow)
 {
-  // Returns matrix of bin errors for a 2D histogram.
-  Int_t first= overflow ? 0 : 1;
+  // Returns sparse matrix of the non-zero bins in a 2D input histogram, normalised as in H2M.
+  // Jet response matrices are nearly banded, so this scales with the number of filled bins.
   if (overflow) {
     nx += 2;
     ny += 2;
   }
-  TMatrixD* m= new TMatrixD (nx, ny);
-  if (!h) return m;
-  for (Int_t j= 0; j < ny; j++) {
-    Double_t fac;
-    if (!norm) fac= 1.0;
-    else {
-      fac= GetBinContent (norm, j, overflow);
-      if (fac != 0.0) fac= 1.0/fac;
+  if (!h) return new TMatrixDSparse (nx, ny);
+  RooUnfoldHistView hv (h, overflow), nv (norm, overflow);
+  std::vector<Double_t> fac (ny, 1.0);
+  if (norm) {
+    for (Int_t j= 0; j < ny; j++) {
+      Double_t f= nv[j];
+      fac[j]= f != 0.0 ? 1.0/f : f;
     }
-    for (Int_t i= 0; i < nx; i++) {
-      // Assume Poisson norm, Multinomial P(mes|tru)
-      (*m)(i,j)= h->GetBinError(i+first,j+first) * fac;
+  }
+  std::vector<Int_t> row, col;
+  std::vector<Double_t> data;
+  for (Int_t i= 0; i < nx; i++) {
+    for (Int_t j= 0; j < ny; j++) {
+      Double_t v= hv(i,j) * fac[j];
+      if (v == 0.0) continue;
+      row.push_back(i);
+      col.push_back(j);
+      data.push_back(v);
     }
   }
-  return m;
+  if (data.empty()) return new TMatrixDSparse (nx, ny);
+  return new TMatrixDSparse (0, nx-1, 0, ny-1, data.size(), &row[0], &col[0], &data[0]);
+}
+
+Int_t
+RooUnfoldResponse::Bandwidth() const
+{
+  // Widest range of truth bins that feed a single measured bin, from the first to the last
+  // non-zero element in each row of the response matrix. Equals the number of truth bins for a dense matrix.
+  const TMatrixDSparse& m= MresponseSparse();
+  const Int_t* irow= m.GetRowIndexArray();
+  const Int_t* icol= m.GetColIndexArray();
+  Int_t width= 0;
+  for (Int_t i= 0; i < m.GetNrows(); i++) {
+    if (irow[i+1] <= irow[i]) continue;
+    Int_t w= icol[irow[i+1]-1] - icol[irow[i]] + 1;
+    if (w > width) width= w;
+  }
+  return width;
+}
+
+Double_t
+RooUnfoldResponse::Occupancy() const
+{
+  // Fraction of response matrix elements that are non-zero
+  const TMatrixDSparse& m= MresponseSparse();
+  Double_t n= Double_t(m.GetNrows()) * m.GetNcols();
+  return n > 0.0 ? m.NonZeros()/n : 0.0;
 }
 
 void RooUnfoldResponse::PrintMatrix(const TMatrixD& m, const char* name, const char* format, Int_t cols_per_sheet)
@@ -847,7 +1035,11 @@ RooUnfoldResponse::ApplyToTruth (const TH1* truth, const char* name) const
     resultvect= new TVectorD (Vtruth());
   }
 
-  (*resultvect) *= Mresponse();   // v= A*v
+  // A jet response matrix is mostly empty off the diagonal, so only multiply the non-zero elements.
+  if (Occupancy() < 0.5)
+    (*resultvect) *= MresponseSparse();   // v= A*v
+  else
+    (*resultvect) *= Mresponse();         // v= A*v
 
   // Turn results vector into properly binned histogram
   TH1* result= (TH1*) Hmeasured()->Clone (name);
@@ -909,18 +1101,25 @@ TF1* RooUnfoldResponse::MakeFoldingFunction (TF1* func, Double_t eps, Bool_t ver
 RooUnfoldResponse* RooUnfoldResponse::RunToy() const
 {
   // Returns new RooUnfoldResponse object with smeared response matrix elements for use as a toy.
+  return RunToy (*gRandom);
+}
+
+RooUnfoldResponse* RooUnfoldResponse::RunToy (TRandom& rnd) const
+{
+  // Returns new RooUnfoldResponse object with response matrix elements smeared using rnd.
+  // Only the new object is modified, so this can be called from several threads with different rnd.
   TString name= GetName();
   name += "_toy";
   RooUnfoldResponse* res= new RooUnfoldResponse (*this);
   res->SetName(name);
-  if (!FakeEntries()) _fak->Reset();
+  if (!FakeEntries()) res->_fak->Reset();
   TH2* hres= res->Hresponse();
   for (Int_t i= 1; i<=_nm; i++) {
     for (Int_t j= 1; j<=_nt; j++) {
       Int_t bin= hres->GetBin (i,j);
       Double_t e= hres->GetBinError (bin);
       if (e>0.0) {
-        Double_t v= hres->GetBinContent(bin) + gRandom->Gaus(0.0,e);
+        Double_t v= hres->GetBinContent(bin) + rnd.Gaus(0.0,e);
         if (v<0.0) v= 0.0;
         hres->SetBinContent (bin, v);
       }
@@ -929,6 +1128,34 @@ RooUnfoldResponse* RooUnfoldResponse::RunToy() const
   return res;
 }
 
+TMatrixD& RooUnfoldResponse::RunToy (TRandom& rnd, TMatrixD& mres) const
+{
+  // Fills mres with a toy response matrix, smeared in the same way as Mresponse() of the object
+  // returned by RunToy(rnd), but without copying this object or touching its histograms.
+  // mres is only resized the first time, so the same buffer can be reused for every toy.
+  // Call Mresponse() and Eresponse() first if several threads share this object.
+  const TMatrixD& m= Mresponse();
+  const TMatrixD& e= Eresponse();
+  mres.ResizeTo (m);
+  Int_t nr= m.GetNrows(), nc= m.GetNcols();
+  Int_t first= _overflow ? 1 : 0;   // under/overflow bins are not smeared
+  const Double_t* pm= m.GetMatrixArray();
+  const Double_t* pe= e.GetMatrixArray();
+  Double_t*       pr= mres.GetMatrixArray();
+  for (Int_t i= 0; i<nr; i++) {
+    for (Int_t j= 0; j<nc; j++) {
+      Int_t k= i*nc+j;
+      Double_t v= pm[k], s= pe[k];
+      if (s>0.0 && i>=first && i<nr-first && j>=first && j<nc-first) {
+        v += rnd.Gaus(0.0,s);
+        if (v<0.0) v= 0.0;
+      }
+      pr[k]= v;
+    }
+  }
+  return mres;
+}
+
 void
 RooUnfoldResponse::SetNameTitleDefault (const char* defname, const char* deftitle)
 {
@@ -17,11 +17,15 @@
 #include "TH1.h"
 #if ROOT_VERSION_CODE >= ROOT_VERSION(5,0,0)
 #include "TVectorDfwd.h"
+#include "TMatrixDSparsefwd.h"
 #else
 class TVectorD;
+class TMatrixDSparse;
 #endif
+#include <vector>
 class TF1;
 class TH2;
+class TRandom;
 class TH2D;
 class TAxis;
 class TCollection;
@@ -108,12 +112,16 @@ public:
   const TVectorD& Etruth()            const;   // Truth distribution errors as a TVectorD
   const TMatrixD& Mresponse()         const;   // Response matrix as a TMatrixD: (row,column)=(measured,truth)
   const TMatrixD& Eresponse()         const;   // Response matrix errors as a TMatrixD: (row,column)=(measured,truth)
+  const TMatrixDSparse& MresponseSparse() const; // Response matrix non-zero elements only, in compressed-row form
+  Int_t        Bandwidth()            const;   // Widest range of truth bins feeding a single measured bin
+  Double_t     Occupancy()            const;   // Fraction of non-zero response matrix elements
 
   Double_t operator() (Int_t r, Int_t t) const;// Response matrix element (measured,truth)
 
   void   UseOverflow (Bool_t set= kTRUE);      // Specify to use overflow bins
   Bool_t UseOverflowStatus() const;            // Get UseOverflow setting
   Double_t FakeEntries() const;                // Return number of bins with fakes
+  Int_t  Version() const;                      // Incremented each time the contents change
   virtual void Print (Option_t* option="") const;
 
   static TH1D*     H2H1D(const TH1*  h, Int_t nb);
@@ -121,6 +129,10 @@ public:
   static TVectorD* H2VE (const TH1*  h, Int_t nb, Bool_t overflow= kFALSE);
   static TMatrixD* H2M  (const TH2*  h, Int_t nx, Int_t ny, const TH1* norm= 0, Bool_t overflow= kFALSE);
   static TMatrixD* H2ME (const TH2*  h, Int_t nx, Int_t ny, const TH1* norm= 0, Bool_t overflow= kFALSE);
+  static TVectorD& H2V  (const TH1*  h, Int_t nb, TVectorD& v, Bool_t overflow= kFALSE); // fill v, reusing its storage
+  static TVectorD& H2VE (const TH1*  h, Int_t nb, TVectorD& v, Bool_t overflow= kFALSE); // fill v, reusing its storage
+  static TMatrixD& H2M  (const TH2*  h, Int_t nx, Int_t ny, TMatrixD& m, const TH1* norm= 0, Bool_t overflow= kFALSE, Bool_t errors= kFALSE); // fill m, reusing its storage
+  static TMatrixDSparse* H2MS (const TH2* h, Int_t nx, Int_t ny, const TH1* norm= 0, Bool_t overflow= kFALSE);
   static void      V2H  (const TVectorD& v, TH1* h, Int_t nb, Bool_t overflow= kFALSE);
   static Int_t   FindBin(const TH1*  h, Double_t x);  // return vector index for bin containing (x)
   static Int_t   FindBin(const TH1*  h, Double_t x, Double_t y);  // return vector index for bin containing (x,y)
@@ -134,12 +146,17 @@ public:
   TF1* MakeFoldingFunction (TF1* func, Double_t eps=1e-12, Bool_t verbose=false) const;
 
   RooUnfoldResponse* RunToy() const;
+  RooUnfoldResponse* RunToy (TRandom& rnd) const;
+  TMatrixD&          RunToy (TRandom& rnd, TMatrixD& mres) const;  // toy response matrix, filled in place
 
 private:
 
   virtual RooUnfoldResponse& Init();
   virtual RooUnfoldResponse& Setup();
   virtual void ClearCache();
+  void Touch (Int_t im, Int_t it);  // Mark cached measured/truth vector elements im/it (-1 for none) as changed
+  void UpdateCache() const;         // Recompute the changed elements of the cached vectors and matrices
+  Int_t CacheIndex (const TH1* h, Double_t x) const;  // 1D vector index of the bin containing x, or -1 if not in the vectors
   virtual void SetNameTitleDefault (const char* defname= 0, const char* deftitle= 0);
   virtual Int_t Miss1D (Double_t xt, Double_t w= 1.0);  // Fill missed event into 1D Response Matrix (with weight)
   virtual Int_t Miss2D (Double_t xt, Double_t yt, Double_t w= 1.0);  // Fill missed event into 2D Response Matrix (with weight)
@@ -168,7 +185,12 @@ private:
   mutable TVectorD* _eTru;   //! Cached truth    error
   mutable TMatrixD* _mRes;   //! Cached response matrix
   mutable TMatrixD* _eRes;   //! Cached response error
+  mutable TMatrixDSparse* _mResSparse; //! Cached response matrix, non-zero elements only
   mutable Bool_t    _cached; //! We are using cached vectors/matrices
+  mutable Bool_t    _dirty;  //! Some cached elements are out of date
+  mutable std::vector<Int_t> _dirtyMes; //! Measured vector elements filled since they were cached
+  mutable std::vector<Int_t> _dirtyTru; //! Truth vector elements (response matrix columns) filled since they were cached
+  Int_t _version;  //! Incremented by each fill, Add, and Reset, so users can tell when to redo derived quantities
 
 public:
 
@@ -306,6 +328,7 @@ inline
 const TVectorD& RooUnfoldResponse::Vmeasured() const
 {
   // Measured distribution as a TVectorD
+  if (_dirty) UpdateCache();
   if (!_vMes) _cached= (_vMes= H2V  (_mes, _nm, _overflow));
   return *_vMes;
 }
@@ -314,6 +337,7 @@ inline
 const TVectorD& RooUnfoldResponse::Vfakes() const
 {
   // Fakes distribution as a TVectorD
+  if (_dirty) UpdateCache();
   if (!_vFak) _cached= (_vFak= H2V  (_fak, _nm, _overflow));
   return *_vFak;
 }
@@ -322,6 +346,7 @@ inline
 const TVectorD& RooUnfoldResponse::Emeasured() const
 {
   // Measured distribution errors as a TVectorD
+  if (_dirty) UpdateCache();
   if (!_eMes) _cached= (_eMes= H2VE (_mes, _nm, _overflow));
   return *_eMes;
 }
@@ -330,6 +355,7 @@ inline
 const TVectorD& RooUnfoldResponse::Vtruth() const
 {
   // Truth distribution as a TVectorD
+  if (_dirty) UpdateCache();
   if (!_vTru) _cached= (_vTru= H2V  (_tru, _nt, _overflow)); 
   return *_vTru;
 }
@@ -338,6 +364,7 @@ inline
 const TVectorD& RooUnfoldResponse::Etruth() const
 {
   // Truth distribution errors as a TVectorD
+  if (_dirty) UpdateCache();
   if (!_eTru) _cached= (_eTru= H2VE (_tru, _nt, _overflow)); 
   return *_eTru;
 }
@@ -346,6 +373,7 @@ inline
 const TMatrixD& RooUnfoldResponse::Mresponse() const
 {
   // Response matrix as a TMatrixD: (row,column)=(measured,truth)
+  if (_dirty) UpdateCache();
   if (!_mRes) _cached= (_mRes= H2M  (_res, _nm, _nt, _tru, _overflow)); 
   return *_mRes;
 }
@@ -354,10 +382,20 @@ inline
 const TMatrixD& RooUnfoldResponse::Eresponse() const
 {
   // Response matrix errors as a TMatrixD: (row,column)=(measured,truth)
+  if (_dirty) UpdateCache();
   if (!_eRes) _cached= (_eRes= H2ME (_res, _nm, _nt, _tru, _overflow)); 
   return *_eRes;
 }
 
+inline
+const TMatrixDSparse& RooUnfoldResponse::MresponseSparse() const
+{
+  // Response matrix in compressed-row form, storing only the non-zero elements: (row,column)=(measured,truth)
+  if (_dirty) UpdateCache();
+  if (!_mResSparse) _cached= (_mResSparse= H2MS (_res, _nm, _nt, _tru, _overflow));
+  return *_mResSparse;
+}
+
 
 inline
 Double_t RooUnfoldResponse::operator() (Int_t r, Int_t t) const
@@ -437,6 +475,10 @@ inline
 void RooUnfoldResponse::UseOverflow (Bool_t set)
 {
   // Specify to use overflow bins. Only supported for 1D truth and measured distributions.
+  if (_overflow != (set ? 1 : 0)) {
+    if (_cached) ClearCache();  // cached vectors change size
+    _version++;
+  }
   _overflow= (set ? 1 : 0);
 }
 
@@ -454,6 +496,14 @@ Double_t RooUnfoldResponse::FakeEntries() const
   return _fak ? _fak->GetEntries() : 0.0;
 }
 
+inline
+Int_t RooUnfoldResponse::Version() const
+{
+  // Incremented each time the contents change (fills, Add, Reset, or a new Setup), so an unfolding object
+  // can tell if quantities it derived from the response are out of date. Direct changes to the histograms are not counted.
+  return _version;
+}
+
 inline
 Int_t RooUnfoldResponse::FindBin (const TH1* h, Double_t x)
 {
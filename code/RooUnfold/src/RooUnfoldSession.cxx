@@ -0,0 +1,117 @@
+//=====================================================================-*-C++-*-
+// File and Version Information:
+//      $Id$
+//
+// Description:
+//      Unfold many measured distributions with the same response matrix.
+//
+//==============================================================================
+
+//____________________________________________________________
+/* BEGIN_HTML
+<p>Unfolds a batch of measured distributions (eg. jackknife samples, systematic
+variations, or toys) with a single response matrix.</p>
+<p>The unfolding object is created once, so quantities that only depend on the
+response are calculated for the first distribution and reused for the rest:
+the response vectors and matrices cached in RooUnfoldResponse, the normalised
+response and efficiencies in RooUnfoldBayes, and the decomposition of the
+response in RooUnfoldInvert. Other algorithms work too, but are set up again
+for each distribution.</p>
+<p>Each measured distribution is given as a vector with its covariance matrix
+(or errors), and the unfolded vector is returned with its covariance matrix,
+using the error treatment set by SetErrorTreatment() (default kCovariance).</p>
+END_HTML */
+
+/////////////////////////////////////////////////////////////
+
+#include "RooUnfoldSession.h"
+
+#include <iostream>
+
+#include "TH1.h"
+
+#include "RooUnfoldResponse.h"
+
+using std::cerr;
+using std::endl;
+using std::vector;
+
+ClassImp (RooUnfoldSession);
+
+RooUnfoldSession::RooUnfoldSession (RooUnfold::Algorithm alg, const RooUnfoldResponse* res, Double_t regparm,
+                                    const char* name, const char* title)
+  : TNamed (name ? name : "session", title ? title : "unfolding session"),
+    _unf(0), _withError(RooUnfold::kCovariance)
+{
+  // Constructor with unfolding algorithm and response matrix object.
+  // The response's measured histogram is used as a placeholder until the first distribution is given.
+  _unf= RooUnfold::New (alg, res, res->Hmeasured(), regparm, name, title);
+}
+
+RooUnfoldSession::~RooUnfoldSession()
+{
+  delete _unf;
+}
+
+Bool_t RooUnfoldSession::Unfold (const TVectorD& meas, const TMatrixD& cov, TVectorD& rec, TMatrixD* reccov)
+{
+  // Unfold measured distribution with covariance matrix cov.
+  if (!_unf) return false;
+  _unf->SetMeasured (meas, cov);
+  return GetResult (rec, reccov);
+}
+
+Bool_t RooUnfoldSession::Unfold (const TVectorD& meas, const TVectorD& err, TVectorD& rec, TMatrixD* reccov)
+{
+  // Unfold measured distribution with uncorrelated errors err.
+  // Passed on as a diagonal covariance matrix, so one from a previous distribution is not reused.
+  Int_t nm= err.GetNrows();
+  TMatrixD cov(nm,nm);
+  for (Int_t i= 0; i<nm; i++) cov(i,i)= err[i]*err[i];
+  return Unfold (meas, cov, rec, reccov);
+}
+
+Bool_t RooUnfoldSession::Unfold (const TH1* meas, TVectorD& rec, TMatrixD* reccov)
+{
+  // Unfold measured histogram, using its bin errors.
+  if (!_unf) return false;
+  const RooUnfoldResponse* res= _unf->response();
+  TVectorD* vmeas= RooUnfoldResponse::H2V  (meas, res->GetNbinsMeasured(), _unf->Overflow());
+  TVectorD* emeas= RooUnfoldResponse::H2VE (meas, res->GetNbinsMeasured(), _unf->Overflow());
+  Bool_t ok= Unfold (*vmeas, *emeas, rec, reccov);
+  delete vmeas;
+  delete emeas;
+  return ok;
+}
+
+Int_t RooUnfoldSession::Unfold (const vector<TVectorD>& meas, const vector<TMatrixD>& cov,
+                                vector<TVectorD>& rec, vector<TMatrixD>* reccov)
+{
+  // Unfold a batch of measured distributions with their covariance matrices.
+  // Returns the number of distributions successfully unfolded.
+  if (meas.size() != cov.size()) {
+    cerr << "Warning: " << meas.size() << " measured distributions, but " << cov.size()
+         << " covariance matrices" << endl;
+    return 0;
+  }
+  rec.resize (meas.size());
+  if (reccov) reccov->resize (meas.size());
+  Int_t nok= 0;
+  for (size_t i= 0; i<meas.size(); i++) {
+    if (Unfold (meas[i], cov[i], rec[i], reccov ? &(*reccov)[i] : 0)) nok++;
+  }
+  return nok;
+}
+
+Bool_t RooUnfoldSession::GetResult (TVectorD& rec, TMatrixD* reccov)
+{
+  const TVectorD& r= _unf->Vreco();
+  rec.ResizeTo (r);
+  rec= r;
+  if (reccov) {
+    TMatrixD c= _unf->Ereco (_withError);
+    reccov->ResizeTo (c);
+    *reccov= c;
+  }
+  return true;
+}
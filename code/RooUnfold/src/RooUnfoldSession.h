@@ -0,0 +1,93 @@
+//=====================================================================-*-C++-*-
+// File and Version Information:
+//      $Id$
+//
+// Description:
+//      Unfold many measured distributions with the same response matrix.
+//
+//==============================================================================
+
+#ifndef ROOUNFOLDSESSION_HH
+#define ROOUNFOLDSESSION_HH
+
+#include <vector>
+
+#include "TNamed.h"
+#include "TVectorD.h"
+#include "TMatrixD.h"
+#include "RooUnfold.h"
+
+class TH1;
+class RooUnfoldResponse;
+
+class RooUnfoldSession : public TNamed {
+
+public:
+
+  RooUnfoldSession(); // default constructor
+  RooUnfoldSession (RooUnfold::Algorithm alg, const RooUnfoldResponse* res, Double_t regparm= -1e30,
+                    const char* name= 0, const char* title= 0);
+  virtual ~RooUnfoldSession(); // destructor
+
+  Bool_t Unfold (const TVectorD& meas, const TMatrixD& cov, TVectorD& rec, TMatrixD* reccov= 0);
+  Bool_t Unfold (const TVectorD& meas, const TVectorD& err, TVectorD& rec, TMatrixD* reccov= 0);
+  Bool_t Unfold (const TH1* meas, TVectorD& rec, TMatrixD* reccov= 0);
+  Int_t  Unfold (const std::vector<TVectorD>& meas, const std::vector<TMatrixD>& cov,
+                 std::vector<TVectorD>& rec, std::vector<TMatrixD>* reccov= 0);
+
+  void SetErrorTreatment (RooUnfold::ErrorTreatment withError);
+  RooUnfold::ErrorTreatment GetErrorTreatment() const;
+  RooUnfold* Impl();
+  const RooUnfoldResponse* response() const;
+
+private:
+  RooUnfoldSession (const RooUnfoldSession& rhs); // not implemented
+  RooUnfoldSession& operator= (const RooUnfoldSession& rhs); // not implemented
+  Bool_t GetResult (TVectorD& rec, TMatrixD* reccov);
+
+  RooUnfold* _unf;                      // Unfolding object, set up once with the response (owned)
+  RooUnfold::ErrorTreatment _withError; // Error treatment for returned covariances
+
+public:
+
+  ClassDef (RooUnfoldSession, 0) // Unfold many measured distributions with one response
+};
+
+// Inline method definitions
+
+inline
+RooUnfoldSession::RooUnfoldSession()
+  : TNamed(), _unf(0), _withError(RooUnfold::kCovariance)
+{
+  // Default constructor.
+}
+
+inline
+void RooUnfoldSession::SetErrorTreatment (RooUnfold::ErrorTreatment withError)
+{
+  // Set error treatment used for the returned covariance matrices (default kCovariance).
+  _withError= withError;
+}
+
+inline
+RooUnfold::ErrorTreatment RooUnfoldSession::GetErrorTreatment() const
+{
+  // Error treatment used for the returned covariance matrices.
+  return _withError;
+}
+
+inline
+RooUnfold* RooUnfoldSession::Impl()
+{
+  // Unfolding object used for all measured distributions, eg. to set options.
+  return _unf;
+}
+
+inline
+const RooUnfoldResponse* RooUnfoldSession::response() const
+{
+  // Response matrix object
+  return _unf ? _unf->response() : 0;
+}
+
+#endif
@@ -16,6 +16,8 @@
 <p>Returns errors as a full matrix of covariances
 <p>Can only handle 1 dimensional distributions
 <p>Can account for both smearing and biasing
+<p>Unfolding again with the same response and measured covariance (eg. after changing only the regularisation parameter
+or the measured distribution) reuses the TSVDUnfold object and its decompositions
 END_HTML */
 
 /////////////////////////////////////////////////////////////
@@ -34,6 +36,7 @@ END_HTML */
 #include "TMatrixD.h"
 
 #include "RooUnfoldResponse.h"
+#include "RooUnfoldHistView.h"
 
 #if (defined(HAVE_TSVDUNFOLD) && !HAVE_TSVDUNFOLD) && ROOT_VERSION_CODE < ROOT_VERSION(5,34,0)
 #define TSVDUNFOLD_LEAK 1
@@ -106,6 +109,8 @@ RooUnfoldSvd::Init()
   _svd= 0;
   _meas1d= _train1d= _truth1d= 0;
   _reshist= _meascov= 0;
+  _svdres= 0;
+  _svdversion= -1;
   GetSettings();
 }
 
@@ -148,34 +153,14 @@ RooUnfoldSvd::Unfold()
 
   Bool_t oldstat= TH1::AddDirectoryStatus();
   TH1::AddDirectory (kFALSE);
-  _meas1d=  HistNoOverflow (_meas,             _overflow);
-  _train1d= HistNoOverflow (_res->Hmeasured(), _overflow);
-  _truth1d= HistNoOverflow (_res->Htruth(),    _overflow);
-  _reshist= _res->HresponseNoOverflow();
-  Resize (_meas1d,  _nb);
-  Resize (_train1d, _nb);
-  Resize (_truth1d, _nb);
-  Resize (_reshist, _nb, _nb);
 
-  // Subtract fakes from measured distribution
-  if (_res->FakeEntries()) {
-    TVectorD fakes= _res->Vfakes();
-    Double_t fac= _res->Vmeasured().Sum();
-    if (fac!=0.0) fac=  Vmeasured().Sum() / fac;
-    if (_verbose>=1) cout << "Subtract " << fac*fakes.Sum() << " fakes from measured distribution" << endl;
-    for (Int_t i= 1; i<=_nm; i++)
-      _meas1d->SetBinContent (i, _meas1d->GetBinContent(i)-(fac*fakes[i-1]));
-  }
-
-  _meascov= new TH2D ("meascov", "meascov", _nb, 0.0, 1.0, _nb, 0.0, 1.0);
-  const TMatrixD& cov= GetMeasuredCov();
-  for (Int_t i= 0; i<_nm; i++)
-    for (Int_t j= 0; j<_nm; j++)
-      _meascov->SetBinContent (i+1, j+1, cov(i,j));
-
-  if (_verbose>=1) cout << "SVD init " << _reshist->GetNbinsX() << " x " << _reshist->GetNbinsY()
-                        << " bins, kreg=" << _kreg << endl;
-  _svd= new TSVDUnfold (_meas1d, _meascov, _train1d, _truth1d, _reshist);
+  if (_svd && _svdres==_res && _svdversion==_res->Version() && _svdcov==GetMeasuredCov()) {
+    // The decompositions only depend on the response and measured covariance, so TSVDUnfold keeps them.
+    // It reads the measured distribution from _meas1d on each unfold, so refill that in place.
+    if (_verbose>=1) cout << "SVD reuse decompositions, kreg=" << _kreg << endl;
+    FillMeasured();
+  } else
+    SetupSvd();
 
   TH1D* rechist= _svd->Unfold (_kreg);
 
@@ -198,6 +183,61 @@ RooUnfoldSvd::Unfold()
   _haveCov=  false;
 }
 
+void
+RooUnfoldSvd::SetupSvd()
+{
+  // Make a new TSVDUnfold object for the current response and measured distribution
+  Destroy();
+  // TSVDUnfold takes non-const histograms and we subtract the fakes, so make padded copies in one pass
+  _meas1d=  HistNoOverflow (_meas,               _overflow, _nb);
+  _train1d= HistNoOverflow (_res->Hmeasured(),   _overflow, _nb);
+  _truth1d= HistNoOverflow (_res->Htruth(),      _overflow, _nb);
+  _reshist= HistNoOverflow (_res->Hresponse(),   _overflow, _nb, _nb);
+  SubtractFakes();
+
+  _meascov= new TH2D ("meascov", "meascov", _nb, 0.0, 1.0, _nb, 0.0, 1.0);
+  const TMatrixD& cov= GetMeasuredCov();
+  for (Int_t i= 0; i<_nm; i++)
+    for (Int_t j= 0; j<_nm; j++)
+      _meascov->SetBinContent (i+1, j+1, cov(i,j));
+
+  if (_verbose>=1) cout << "SVD init " << _reshist->GetNbinsX() << " x " << _reshist->GetNbinsY()
+                        << " bins, kreg=" << _kreg << endl;
+  _svd= new TSVDUnfold (_meas1d, _meascov, _train1d, _truth1d, _reshist);
+  _svdres= _res;
+  _svdversion= _res->Version();
+  _svdcov.ResizeTo (_nm, _nm);
+  _svdcov= GetMeasuredCov();
+}
+
+void
+RooUnfoldSvd::FillMeasured()
+{
+  // Refill _meas1d with the current measured distribution, as HistNoOverflow does, without replacing
+  // the histogram, which the TSVDUnfold object keeps a pointer to
+  RooUnfoldHistView hv (_meas, _overflow);
+  Bool_t s= _meas->GetSumw2N();
+  Int_t n= hv.Size() < _nb ? hv.Size() : _nb;
+  for (Int_t i= 0; i < n; i++) {
+           _meas1d->SetBinContent (i+1, hv[i]);
+    if (s) _meas1d->SetBinError   (i+1, hv.Error(i));
+  }
+  SubtractFakes();
+}
+
+void
+RooUnfoldSvd::SubtractFakes()
+{
+  // Subtract fakes from measured distribution
+  if (!_res->FakeEntries()) return;
+  TVectorD fakes= _res->Vfakes();
+  Double_t fac= _res->Vmeasured().Sum();
+  if (fac!=0.0) fac=  Vmeasured().Sum() / fac;
+  if (_verbose>=1) cout << "Subtract " << fac*fakes.Sum() << " fakes from measured distribution" << endl;
+  for (Int_t i= 1; i<=_nm; i++)
+    _meas1d->SetBinContent (i, _meas1d->GetBinContent(i)-(fac*fakes[i-1]));
+}
+
 void
 RooUnfoldSvd::GetCov()
 {
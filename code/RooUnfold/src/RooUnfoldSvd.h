@@ -67,6 +67,9 @@ private:
   void Init();
   void Destroy();
   void CopyData (const RooUnfoldSvd& rhs);
+  void SetupSvd();
+  void FillMeasured();
+  void SubtractFakes();
 
 protected:
   // instance variables
@@ -76,6 +79,9 @@ protected:
 
   TH1D *_meas1d, *_train1d, *_truth1d;
   TH2D *_reshist, *_meascov;
+  const RooUnfoldResponse* _svdres;  //! response used to set up _svd
+  Int_t    _svdversion;              //! RooUnfoldResponse::Version() of _svdres when _svd was set up
+  TMatrixD _svdcov;                  //! measured covariance used to set up _svd
 
 public:
   ClassDef (RooUnfoldSvd, 1) // SVD Unfolding (interface to TSVDUnfold)
@@ -125,8 +131,9 @@ RooUnfoldSvd::~RooUnfoldSvd()
 inline
 void RooUnfoldSvd::SetKterm (Int_t kreg)
 {
-  // Set regularisation parameter
+  // Set regularisation parameter. Unfolding again with a new kreg reuses the SVD decompositions.
   _kreg= kreg;
+  _unfolded= _haveCov= _haveWgt= _haveErrors= _have_err_mat= _fail= kFALSE;
 }
 
 
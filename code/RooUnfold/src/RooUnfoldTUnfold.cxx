@@ -20,6 +20,13 @@
 <p>Regularisation parameter can be either optimised internally by plotting log10(chi2 squared) against log10(tau). The 'kink' in this curve is deemed the optimum tau value. This value can also be set manually (FixTau)
 <p>The latest version (TUnfold 15 in ROOT 2.27.04) will not handle plots with an additional underflow bin. As a result overflows must be turned off
 if v15 of TUnfold is used. ROOT versions 5.26 or below use v13 and so should be safe to use overflows.</ul>
+<p>The L-curve scan is done here rather than with TUnfold::ScanLcurve, so that the points can be shared between
+NThreads() threads, each with its own TUnfold object. The first SetLcurveScan(nscan) points are spread evenly in log(tau),
+from the largest useful tau (where the regularisation term is comparable to the chi squared of the unregularised result)
+down four decades, and nrefine more are added between the neighbours of the kink (the point of largest curvature).
+The tau found is kept for the rest of the session, keyed by the response matrix, binning, and regularisation method,
+so later unfoldings with the same response (eg. toys or other measured distributions) do not repeat the scan.
+Use ClearTauCache() to scan again.</p>
 END_HTML */
 
 /////////////////////////////////////////////////////////////
@@ -27,6 +34,12 @@ END_HTML */
 #include "RooUnfoldTUnfold.h"
 
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 #include "TH1.h"
 #include "TH2.h"
@@ -41,6 +54,7 @@ END_HTML */
 #include "TSpline.h"
 
 #include "RooUnfoldResponse.h"
+#include "RooUnfoldToys.h"
 
 using std::cout;
 using std::cerr;
@@ -48,6 +62,10 @@ using std::endl;
 
 ClassImp (RooUnfoldTUnfold);
 
+// tau from earlier L-curve scans, keyed by RooUnfoldTUnfold::TauKey()
+static std::map<ULong64_t,Double_t> tauCache;
+static std::mutex tauCacheMutex;
+
 RooUnfoldTUnfold::RooUnfoldTUnfold (const RooUnfoldTUnfold& rhs)
   : RooUnfold (rhs)
 {
@@ -115,6 +133,8 @@ RooUnfoldTUnfold::CopyData (const RooUnfoldTUnfold& rhs)
   tau_set=rhs.tau_set;
   _tau=rhs._tau;
   _reg_method=rhs._reg_method;
+  _nscan=rhs._nscan;
+  _nrefine=rhs._nrefine;
   _lCurve  = (rhs._lCurve  ? dynamic_cast<TGraph*> (rhs._lCurve ->Clone()) : 0);
   _logTauX = (rhs._logTauX ? dynamic_cast<TSpline*>(rhs._logTauX->Clone()) : 0);
   _logTauY = (rhs._logTauY ? dynamic_cast<TSpline*>(rhs._logTauY->Clone()) : 0);
@@ -130,6 +150,8 @@ RooUnfoldTUnfold::Init()
   _lCurve = 0;
   _logTauX = 0;
   _logTauY = 0;
+  _nscan = 15;
+  _nrefine = 15;
   GetSettings();
 }
 
@@ -194,78 +216,232 @@ RooUnfoldTUnfold::Unfold()
       meas->SetBinContent (i, meas->GetBinContent(i)-(fac*fakes[i-1]));
   }
 
-  Int_t ndim= _meas->GetDimension();
   TUnfold::ERegMode reg= _reg_method;
+  Int_t ndim= _meas->GetDimension();
   if (ndim == 2 || ndim == 3) reg= TUnfold::kRegModeNone;  // set explicitly
 
+  delete _unf;
+  _unf= NewTUnfold (Hres, meas, reg, kTRUE);
+  //_unf->SetConstraint(TUnfold::kEConstraintArea);
+  if (!tau_set){
+    // find the kink in the L curve, or use the tau found before for this response
+    ULong64_t key= TauKey (Hres, reg);
+    Bool_t cached= false;
+    {
+      std::lock_guard<std::mutex> lock (tauCacheMutex);
+      std::map<ULong64_t,Double_t>::const_iterator it= tauCache.find (key);
+      if (it != tauCache.end()) {
+        _tau= it->second;
+        cached= true;
+      }
+    }
+    if (cached) {
+      if (_verbose>=1) cout << "Use tau= " << _tau << " from earlier L-curve scan" << endl;
+    } else {
+      delete _lCurve;  _lCurve  = 0;
+      delete _logTauX; _logTauX = 0;
+      delete _logTauY; _logTauY = 0;
+      if (!ScanTau (Hres, meas, reg)) {
+        // use TUnfold's own scan: start with taumin=taumax=0.0 for automatic range
+        Int_t bestPoint = _unf->ScanLcurve(_nscan+_nrefine,0.0,0.0,&_lCurve,&_logTauX,&_logTauY);
+        _tau=_unf->GetTau();
+        cout <<"Lcurve scan chose tau= "<<_tau<<endl<<" at point "<<bestPoint<<endl;
+      }
+      std::lock_guard<std::mutex> lock (tauCacheMutex);
+      tauCache[key]= _tau;
+    }
+  }
+  _unf->DoUnfold(_tau);
+  TH1D reco("_rec","reconstructed dist",_nt,0.0,_nt);
+  _unf->GetOutput(&reco);
+  _rec.ResizeTo (_nt);
+  for (int i=0;i<_nt;i++){
+    _rec(i)=(reco.GetBinContent(i+1));
+  }
+
+  if (_verbose>=2) {
+    TH1* train1d= HistNoOverflow (_res->Hmeasured(), _overflow);
+    TH1* truth1d= HistNoOverflow (_res->Htruth(),    _overflow);
+    PrintTable (cout, truth1d, train1d, 0, meas, &reco, _nm, _nt, kTRUE);
+    delete truth1d;
+    delete train1d;
+  }
+
+  delete meas;
+  delete Hres;
+  _unfolded= true;
+  _haveCov=  false;
+}
+
+TUnfold*
+RooUnfoldTUnfold::NewTUnfold (TH2D* Hres, TH1D* meas, TUnfold::ERegMode reg, Bool_t warn) const
+{
+  // New TUnfold object for response Hres with regularisation and input meas
+  TUnfold* unf;
 #ifndef NOTUNFOLDSYS
   if (_dosys)
-    _unf= new TUnfoldSys(Hres,TUnfold::kHistMapOutputVert,reg);
+    unf= new TUnfoldSys(Hres,TUnfold::kHistMapOutputVert,reg);
   else
 #endif
-    _unf= new TUnfold(Hres,TUnfold::kHistMapOutputVert,reg);
+    unf= new TUnfold(Hres,TUnfold::kHistMapOutputVert,reg);
 
+  Int_t ndim= _meas->GetDimension();
   if        (ndim == 2) {
     Int_t nx= _meas->GetNbinsX(), ny= _meas->GetNbinsY();
-    _unf->RegularizeBins2D (0, 1, nx, nx, ny, _reg_method);
+    unf->RegularizeBins2D (0, 1, nx, nx, ny, _reg_method);
   } else if (ndim == 3) {
     Int_t nx= _meas->GetNbinsX(), ny= _meas->GetNbinsY(), nz= _meas->GetNbinsZ(), nxy= nx*ny;
     for (Int_t i= 0; i<nx; i++) {
-      _unf->RegularizeBins2D (    i, nx, ny, nxy, nz, _reg_method);
+      unf->RegularizeBins2D (    i, nx, ny, nxy, nz, _reg_method);
     }
     for (Int_t i= 0; i<ny; i++) {
-      _unf->RegularizeBins2D ( nx*i,  1, nx, nxy, nz, _reg_method);
+      unf->RegularizeBins2D ( nx*i,  1, nx, nxy, nz, _reg_method);
     }
     for (Int_t i= 0; i<nz; i++) {
-      _unf->RegularizeBins2D (nxy*i,  1, nx,  nx, ny, _reg_method);
+      unf->RegularizeBins2D (nxy*i,  1, nx,  nx, ny, _reg_method);
     }
   }
 
-  Int_t nScan=30;
-  // use automatic L-curve scan: start with taumin=taumax=0.0
-  Double_t tauMin=0.0;
-  Double_t tauMax=0.0;
-  // this method scans the parameter tau and finds the kink in the L curve
-  // finally, the unfolding is done for the best choice of tau
 #if ROOT_VERSION_CODE >= ROOT_VERSION(5,23,0)  /* TUnfold v6 (included in ROOT 5.22) didn't have setInput return value */
-  Int_t stat= _unf->SetInput(meas);
-  if(stat>=10000) {
+  Int_t stat= unf->SetInput(meas);
+  if(warn && stat>=10000) {
     cerr<<"Unfolding result may be wrong: " << stat/10000 << " unconstrained output bins\n";
   }
 #else
-  _unf->SetInput(meas);
+  unf->SetInput(meas);
 #endif
-  //_unf->SetConstraint(TUnfold::kEConstraintArea);
-  if (!tau_set){
-    delete _lCurve;  _lCurve  = 0;
-    delete _logTauX; _logTauX = 0;
-    delete _logTauY; _logTauY = 0;
-    Int_t bestPoint = _unf->ScanLcurve(nScan,tauMin,tauMax,&_lCurve,&_logTauX,&_logTauY);
-    _tau=_unf->GetTau();  // save value, even if we don't use it unless tau_set
-    cout <<"Lcurve scan chose tau= "<<_tau<<endl<<" at point "<<bestPoint<<endl;
+  return unf;
+}
+
+ULong64_t
+RooUnfoldTUnfold::TauKey (const TH2D* Hres, TUnfold::ERegMode reg) const
+{
+  // Hash of the response matrix contents, binning, and regularisation settings, used to look up tau
+  ULong64_t key= RooUnfoldRandom::Mix (0x2545f4914f6cdd1dULL + ULong64_t(reg));
+  Int_t dims[]= { _meas->GetDimension(), _meas->GetNbinsX(), _meas->GetNbinsY(), _meas->GetNbinsZ(),
+                  _nm, _nt, _overflow, _reg_method, _dosys };
+  for (UInt_t i= 0; i<sizeof(dims)/sizeof(dims[0]); i++)
+    key= RooUnfoldRandom::Mix (key ^ ULong64_t(dims[i]));
+  for (Int_t i= 0; i<=Hres->GetNbinsX()+1; i++) {
+    for (Int_t j= 0; j<=Hres->GetNbinsY()+1; j++) {
+      Double_t v= Hres->GetBinContent(i,j);
+      ULong64_t bits;
+      memcpy (&bits, &v, sizeof(bits));
+      key= RooUnfoldRandom::Mix (key ^ bits);
+    }
   }
-  else{
-    _unf->DoUnfold(_tau);
+  return key;
+}
+
+void
+RooUnfoldTUnfold::LcurvePoints (TH2D* Hres, TH1D* meas, TUnfold::ERegMode reg, const std::vector<Double_t>* logTau,
+                                Int_t first, Int_t last, std::vector<Double_t>* x, std::vector<Double_t>* y) const
+{
+  // L-curve points for log10(tau) values first..last-1, with our own TUnfold object
+  TUnfold* unf= NewTUnfold (Hres, meas, reg, kFALSE);
+  for (Int_t i= first; i<last; i++) {
+    unf->DoUnfold (pow (10.0, (*logTau)[i]));
+    (*x)[i]= unf->GetLcurveX();
+    (*y)[i]= unf->GetLcurveY();
   }
-  TH1D reco("_rec","reconstructed dist",_nt,0.0,_nt);
-  _unf->GetOutput(&reco);
-  _rec.ResizeTo (_nt);
-  for (int i=0;i<_nt;i++){
-    _rec(i)=(reco.GetBinContent(i+1));
+  delete unf;
+}
+
+static Int_t
+FindKink (std::vector<Double_t>& t, std::vector<Double_t>& x, std::vector<Double_t>& y,
+          TSpline3*& splineX, TSpline3*& splineY)
+{
+  // Point with the largest curvature of the L curve (x(t),y(t)), using splines in t=log10(tau).
+  Int_t n= t.size();
+  splineX= new TSpline3 ("log(chi**2)%log(tau)", &t[0], &x[0], n);
+  splineY= new TSpline3 ("log(reg.cond)%log(tau)", &t[0], &y[0], n);
+  Int_t best= -1;
+  Double_t cmax= 0.0;
+  for (Int_t i= 1; i<n-1; i++) {
+    Double_t tx, ty, bx, cx, dx, by, cy, dy;
+    splineX->GetCoeff (i, tx, ty, bx, cx, dx);
+    splineY->GetCoeff (i, tx, ty, by, cy, dy);
+    Double_t d= bx*bx + by*by;
+    if (d<=0.0) continue;
+    Double_t c= (bx*2*cy - by*2*cx) / (d*sqrt(d));
+    if (best<0 || c>cmax) {
+      best= i;
+      cmax= c;
+    }
   }
+  return best;
+}
 
-  if (_verbose>=2) {
-    TH1* train1d= HistNoOverflow (_res->Hmeasured(), _overflow);
-    TH1* truth1d= HistNoOverflow (_res->Htruth(),    _overflow);
-    PrintTable (cout, truth1d, train1d, 0, meas, &reco, _nm, _nt, kTRUE);
-    delete truth1d;
-    delete train1d;
+Bool_t
+RooUnfoldTUnfold::ScanTau (TH2D* Hres, TH1D* meas, TUnfold::ERegMode reg)
+{
+  // L-curve scan, with the points shared between threads, followed by a finer scan around the kink.
+  // Sets _tau, _lCurve, _logTauX, and _logTauY. Returns false if the tau range can not be found.
+
+  // The largest tau is where the regularisation term is comparable to the chi**2 without regularisation
+  _unf->DoUnfold (0.0);
+  Int_t ndf= _unf->GetNdf();
+  Double_t chi2A= _unf->GetChi2A(), ly0= _unf->GetLcurveY();
+  if (ndf<=0 || _nscan<4 || !(ly0>-1e30 && ly0<1e30)) return false;
+  Double_t logTauMax= 0.5*(log10 (chi2A+3.0*sqrt(ndf+1.0)) - ly0);
+  Double_t logTauMin= logTauMax-4.0;
+
+  Int_t nthreads= ToyThreads (std::max (_nscan, _nrefine), kFALSE);  // points in either pass, each with its own TUnfold
+
+  std::vector<Double_t> t, x, y;
+  Double_t step= (logTauMax-logTauMin)/(_nscan-1);
+  for (Int_t i= 0; i<_nscan; i++) t.push_back (logTauMin + i*step);
+  TSpline3 *splineX= 0, *splineY= 0;
+  Int_t best= -1;
+  for (Int_t pass= 0; pass<2; pass++) {
+    Int_t first= x.size(), n= t.size(), nt= std::min (nthreads, n-first);
+    x.resize (n);
+    y.resize (n);
+    if (nt<=1) {
+      LcurvePoints (Hres, meas, reg, &t, first, n, &x, &y);
+    } else {
+      std::vector<std::thread> threads;
+      for (Int_t k= 0; k<nt; k++)
+        threads.push_back (std::thread (&RooUnfoldTUnfold::LcurvePoints, this, Hres, meas, reg, &t,
+                                        first + Int_t((Long64_t(k)*(n-first))/nt), first + Int_t((Long64_t(k+1)*(n-first))/nt),
+                                        &x, &y));
+      for (Int_t k= 0; k<nt; k++) threads[k].join();
+    }
+
+    // sort the points in tau
+    std::vector<std::pair<Double_t,std::pair<Double_t,Double_t> > > pts;
+    for (Int_t i= 0; i<n; i++) pts.push_back (std::make_pair (t[i], std::make_pair (x[i], y[i])));
+    std::sort (pts.begin(), pts.end());
+    for (Int_t i= 0; i<n; i++) {
+      t[i]= pts[i].first;
+      x[i]= pts[i].second.first;
+      y[i]= pts[i].second.second;
+    }
+
+    delete splineX; delete splineY;
+    best= FindKink (t, x, y, splineX, splineY);
+    if (best<0) break;
+    if (pass>0 || _nrefine<=0) break;
+
+    // add points between the neighbours of the kink
+    Double_t lo= t[best-1], hi= t[best+1], fine= (hi-lo)/(_nrefine+1);
+    for (Int_t i= 1; i<=_nrefine; i++) {
+      Double_t ti= lo + i*fine;
+      if (fabs (ti-t[best]) > 1e-3*fine) t.push_back (ti);
+    }
+  }
+  if (best<0) {
+    delete splineX; delete splineY;
+    return false;
   }
 
-  delete meas;
-  delete Hres;
-  _unfolded= true;
-  _haveCov=  false;
+  _tau= pow (10.0, t[best]);
+  _lCurve= new TGraph (t.size(), &x[0], &y[0]);
+  _lCurve->SetNameTitle ("L curve", "L curve");
+  _logTauX= splineX;
+  _logTauY= splineY;
+  cout <<"Lcurve scan chose tau= "<<_tau<<endl<<" at point "<<best<<" of "<<t.size()<<endl;
+  return true;
 }
 
 void
@@ -319,6 +495,22 @@ RooUnfoldTUnfold::SetRegMethod(TUnfold::ERegMode regmethod)
   _reg_method=regmethod;
 }
 
+void
+RooUnfoldTUnfold::SetLcurveScan (Int_t nscan, Int_t nrefine)
+{
+  // Number of points in the L-curve scan, and the number added between the neighbours of the kink
+  _nscan= nscan;
+  _nrefine= nrefine;
+}
+
+void
+RooUnfoldTUnfold::ClearTauCache()
+{
+  // Forget the tau values found by earlier L-curve scans, so that the next unfolding scans again
+  std::lock_guard<std::mutex> lock (tauCacheMutex);
+  tauCache.clear();
+}
+
 void
 RooUnfoldTUnfold::OptimiseTau()
 {
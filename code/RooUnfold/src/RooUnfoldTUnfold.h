@@ -12,6 +12,8 @@
 #ifndef ROOUNFOLDTUNFOLD_H_
 #define ROOUNFOLDTUNFOLD_H_
 
+#include <vector>
+
 #include "RooUnfold.h"
 #include "TUnfold.h"
 
@@ -50,6 +52,8 @@ public:
   virtual Double_t GetRegParm() const;
   void SetRegMethod (TUnfold::ERegMode regmethod);
   TUnfold::ERegMode GetRegMethod() const;
+  void SetLcurveScan (Int_t nscan, Int_t nrefine= 0); // Points in the L-curve scan, and in its refinement around the kink
+  static void ClearTauCache(); // Forget the tau values found by earlier L-curve scans
 
 protected:
   void Init();
@@ -59,6 +63,11 @@ protected:
   virtual void GetSettings();
   void Assign   (const RooUnfoldTUnfold& rhs); // implementation of assignment operator
   void CopyData (const RooUnfoldTUnfold& rhs);
+  TUnfold* NewTUnfold (TH2D* Hres, TH1D* meas, TUnfold::ERegMode reg, Bool_t warn) const;
+  Bool_t ScanTau (TH2D* Hres, TH1D* meas, TUnfold::ERegMode reg);
+  void LcurvePoints (TH2D* Hres, TH1D* meas, TUnfold::ERegMode reg, const std::vector<Double_t>* logTau,
+                     Int_t first, Int_t last, std::vector<Double_t>* x, std::vector<Double_t>* y) const;
+  ULong64_t TauKey (const TH2D* Hres, TUnfold::ERegMode reg) const;
 
 private:
   TUnfold::ERegMode _reg_method; //Regularisation method
@@ -68,10 +77,12 @@ private:
   TSpline* _logTauX;
   TSpline* _logTauY;
   TGraph*  _lCurve;
+  Int_t _nscan;   // Number of points in the L-curve scan
+  Int_t _nrefine; // Number of points added around the kink
 
 public:
 
-  ClassDef (RooUnfoldTUnfold, 1)   // Interface to TUnfold
+  ClassDef (RooUnfoldTUnfold, 2)   // Interface to TUnfold
 };
 
 // Inline method definitions
@@ -0,0 +1,149 @@
+//=====================================================================-*-C++-*-
+// File and Version Information:
+//      $Id$
+//
+// Description:
+//      Random numbers and running statistics for toy studies.
+//
+//==============================================================================
+
+//____________________________________________________________
+/* BEGIN_HTML
+<p>RooUnfoldRandom is a counter-based generator: the n-th number of stream
+(seed,stream) is a hash of the stream key and n, so there is no state to share
+between toys. Giving each toy its own stream, keyed by (seed,toy number), makes
+the toys independent of which thread runs them, or in which order.
+Gaussian and other distributions come from the TRandom base class.</p>
+<p>RooUnfoldWelford accumulates the mean and covariance of the toy results one toy at
+a time, with Welford's method, so the sums are never differences of large numbers.
+Accumulators filled in different threads are combined with Add(other).</p>
+END_HTML */
+
+/////////////////////////////////////////////////////////////
+
+#include "RooUnfoldToys.h"
+
+ClassImp (RooUnfoldRandom);
+
+RooUnfoldRandom::RooUnfoldRandom (ULong64_t seed, ULong64_t stream)
+  : TRandom()
+{
+  SetStream (seed, stream);
+}
+
+RooUnfoldRandom::~RooUnfoldRandom()
+{
+}
+
+ULong64_t RooUnfoldRandom::Mix (ULong64_t x)
+{
+  // SplitMix64 finaliser
+  x ^= x >> 30;  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+void RooUnfoldRandom::SetStream (ULong64_t seed, ULong64_t stream)
+{
+  // Restart at the beginning of stream (seed,stream)
+  _key= Mix (Mix (seed + 0x9e3779b97f4a7c15ULL) ^ (stream + 0x632be59bd9b4e019ULL));
+  _counter= 0;
+  fSeed= seed;
+}
+
+void RooUnfoldRandom::SetSeed (ULong_t seed)
+{
+  SetStream (seed, 0);
+}
+
+Double_t RooUnfoldRandom::Rndm()
+{
+  // Uniform number in (0,1), never exactly 0 or 1
+  ULong64_t x= Mix (_key + (++_counter) * 0x9e3779b97f4a7c15ULL);
+  return ((x >> 11) + 0.5) * (1.0/9007199254740992.0);
+}
+
+void RooUnfoldRandom::RndmArray (Int_t n, Float_t* array)
+{
+  for (Int_t i= 0; i<n; i++) array[i]= Rndm();
+}
+
+void RooUnfoldRandom::RndmArray (Int_t n, Double_t* array)
+{
+  for (Int_t i= 0; i<n; i++) array[i]= Rndm();
+}
+
+//____________________________________________________________
+
+RooUnfoldWelford::RooUnfoldWelford (Int_t n)
+{
+  Reset (n);
+}
+
+void RooUnfoldWelford::Reset (Int_t n)
+{
+  _n= 0;
+  _mean.ResizeTo (n);
+  _m2  .ResizeTo (n, n);
+  _d   .ResizeTo (n);
+  _mean.Zero();
+  _m2  .Zero();
+}
+
+void RooUnfoldWelford::Add (const TVectorD& x)
+{
+  // Add one toy result
+  Int_t n= _mean.GetNrows();
+  _n++;
+  Double_t* d= _d.GetMatrixArray();
+  Double_t* m= _mean.GetMatrixArray();
+  Double_t* m2= _m2.GetMatrixArray();
+  const Double_t* px= x.GetMatrixArray();
+  Double_t f= 1.0/_n;
+  for (Int_t i= 0; i<n; i++) {
+    d[i]= px[i] - m[i];
+    m[i] += d[i]*f;
+  }
+  // M2 += (x-oldmean)(x-newmean)^T
+  for (Int_t i= 0; i<n; i++) {
+    Double_t di= d[i];
+    if (di==0.0) continue;
+    Double_t* m2i= m2 + i*n;
+    for (Int_t j= i; j<n; j++) m2i[j] += di * (px[j] - m[j]);
+  }
+}
+
+void RooUnfoldWelford::Add (const RooUnfoldWelford& other)
+{
+  // Merge results accumulated separately (Chan et al.)
+  if (other._n==0) return;
+  if (_n==0) {
+    _n= other._n;
+    _mean= other._mean;
+    _m2= other._m2;
+    return;
+  }
+  Int_t n= _mean.GetNrows();
+  Long64_t nab= _n + other._n;
+  Double_t fb= Double_t(other._n)/nab, fab= Double_t(_n)*other._n/nab;
+  for (Int_t i= 0; i<n; i++) _d[i]= other._mean[i] - _mean[i];
+  for (Int_t i= 0; i<n; i++) {
+    for (Int_t j= i; j<n; j++)
+      _m2(i,j) += other._m2(i,j) + _d[i]*_d[j]*fab;
+    _mean[i] += _d[i]*fb;
+  }
+  _n= nab;
+}
+
+TMatrixD& RooUnfoldWelford::Covariance (TMatrixD& cov) const
+{
+  // Unbiased sample covariance of the toys added so far
+  Int_t n= _mean.GetNrows();
+  cov.ResizeTo (n, n);
+  Double_t f= _n > 1 ? 1.0/(_n-1) : 0.0;
+  for (Int_t i= 0; i<n; i++) {
+    for (Int_t j= i; j<n; j++) cov(i,j)= cov(j,i)= _m2(i,j)*f;
+  }
+  return cov;
+}
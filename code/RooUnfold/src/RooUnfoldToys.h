@@ -0,0 +1,79 @@
+//=====================================================================-*-C++-*-
+// File and Version Information:
+//      $Id$
+//
+// Description:
+//      Random numbers and running statistics for toy studies.
+//
+//==============================================================================
+
+#ifndef ROOUNFOLDTOYS_HH
+#define ROOUNFOLDTOYS_HH
+
+#include "TRandom.h"
+#include "TVectorD.h"
+#include "TMatrixD.h"
+
+class RooUnfoldRandom : public TRandom {
+
+public:
+
+  RooUnfoldRandom (ULong64_t seed= 0, ULong64_t stream= 0);
+  virtual ~RooUnfoldRandom();
+
+  void SetStream (ULong64_t seed, ULong64_t stream);  // restart at the beginning of stream (seed,stream)
+  virtual void     SetSeed (ULong_t seed= 0);         // same as SetStream(seed,0)
+  virtual Double_t Rndm();
+  virtual void     RndmArray (Int_t n, Float_t*  array);
+  virtual void     RndmArray (Int_t n, Double_t* array);
+
+  static ULong64_t Mix (ULong64_t x);  // 64-bit finaliser used to derive the stream key and each number
+
+private:
+
+  ULong64_t _key;      // derived from (seed,stream)
+  ULong64_t _counter;  // number of values drawn from this stream
+
+public:
+
+  ClassDef (RooUnfoldRandom, 0) // Counter-based random number streams for toys
+};
+
+class RooUnfoldWelford {
+
+public:
+
+  RooUnfoldWelford (Int_t n= 0);
+
+  void     Reset (Int_t n);
+  void     Add   (const TVectorD& x);               // add one toy result
+  void     Add   (const RooUnfoldWelford& other);   // merge results accumulated separately
+  Long64_t Entries() const;
+  const TVectorD& Mean() const;
+  TMatrixD& Covariance (TMatrixD& cov) const;       // unbiased sample covariance
+
+private:
+
+  Long64_t _n;     // number of entries
+  TVectorD _mean;  // running mean
+  TMatrixD _m2;    // sum of (x-mean)(x-mean)^T, upper triangle only
+  TVectorD _d;     // work space
+};
+
+// Inline method definitions
+
+inline
+Long64_t RooUnfoldWelford::Entries() const
+{
+  // Number of toys added
+  return _n;
+}
+
+inline
+const TVectorD& RooUnfoldWelford::Mean() const
+{
+  // Mean of the toys added so far
+  return _mean;
+}
+
+#endif
@@ -19,6 +19,9 @@
 #pragma link C++ class RooUnfoldDagostini+;
 #endif
 #pragma link C++ class RooUnfoldIds-;
+#pragma link C++ class RooUnfoldSession+;
+#pragma link C++ class RooUnfoldBatch+;
+#pragma link C++ class RooUnfoldRandom+;
 #if !defined(HAVE_TSVDUNFOLD) || HAVE_TSVDUNFOLD
 #pragma link C++ class TSVDUnfold_130729+;
 #endif
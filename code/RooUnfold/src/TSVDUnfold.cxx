@@ -50,7 +50,7 @@ TSVDUnfold *tsvdunf = new TSVDUnfold( bdat, Bcov, bini, xini, Adet );
 TH1D* unfresult = tsvdunf->Unfold( kreg );
 </pre>
 </ul>
-where <tt>kreg</tt> determines the regularisation of the unfolding. In general, overregularisation (too small <tt>kreg</tt>) will bias the unfolded spectrum towards the Monte Carlo input, while underregularisation (too large <tt>kreg</tt>) will lead to large fluctuations in the unfolded spectrum. The optimal regularisation can be determined following guidelines in <a href="http://arXiv.org/abs/hep-ph/9509307">Nucl. Instrum. Meth. A372, 469 (1996) [hep-ph/9509307]</a> using the distribution of the <tt>|d_i|<\tt> that can be obtained by <tt>tsvdunf->GetD()</tt> and/or using pseudo-experiments.
+where <tt>kreg</tt> determines the regularisation of the unfolding. The decompositions of the response and covariance matrices are only done by the first call, so further calls with another <tt>kreg</tt>, or with a continuous regularisation parameter using <tt>tsvdunf->UnfoldTau( tau )</tt>, only apply the damping factors. In general, overregularisation (too small <tt>kreg</tt>) will bias the unfolded spectrum towards the Monte Carlo input, while underregularisation (too large <tt>kreg</tt>) will lead to large fluctuations in the unfolded spectrum. The optimal regularisation can be determined following guidelines in <a href="http://arXiv.org/abs/hep-ph/9509307">Nucl. Instrum. Meth. A372, 469 (1996) [hep-ph/9509307]</a> using the distribution of the <tt>|d_i|<\tt> that can be obtained by <tt>tsvdunf->GetD()</tt> and/or using pseudo-experiments.
 <p>
 Covariance matrices on the measured spectrum (for either the total uncertainties or individual sources of uncertainties) can be propagated to covariance matrices using the <tt>GetUnfoldCovMatrix</tt> method, which uses pseudo experiments for the propagation. In addition, <tt>GetAdetCovMatrix</tt> allows for the propagation of the statistical uncertainties on the response matrix using pseudo experiments. The covariance matrix corresponding to <tt>Bcov</tt> is also computed as described in <a href="http://arXiv.org/abs/hep-ph/9509307">Nucl. Instrum. Meth. A372, 469 (1996) [hep-ph/9509307]</a> and can be obtained from <tt>tsvdunf->GetXtau()</tt> and its (regularisation independent) inverse from  <tt>tsvdunf->GetXinv()</tt>. The distribution of singular values can be retrieved using <tt>tsvdunf->GetSV()</tt>.
 <p>
@@ -62,6 +62,7 @@ End_Html */
 #include <iostream>
 
 #include "TSVDUnfold_local.h"
+#include "RooUnfold.h"
 #include "TH1D.h"
 #include "TH2D.h"
 #include "TDecompSVD.h"
@@ -90,7 +91,9 @@ TSVDUnfold::TSVDUnfold( const TH1D *bdat, const TH1D *bini, const TH1D *xini, co
     fToyhisto   (NULL),
     fToymat     (NULL),
     fToyMode    (kFALSE),
-    fMatToyMode (kFALSE)
+    fMatToyMode (kFALSE),
+    fHaveSVD    (kFALSE),
+    fTau        (0)
 {
   // Alternative constructor
   // User provides data and MC test spectra, as well as detector response matrix, diagonal covariance matrix of measured spectrum built from the uncertainties on measured spectrum
@@ -142,7 +145,9 @@ TSVDUnfold::TSVDUnfold( const TH1D *bdat, TH2D* Bcov, const TH1D *bini, const TH
      fToyhisto   (NULL),
      fToymat     (NULL),
      fToyMode    (kFALSE),
-     fMatToyMode (kFALSE) 
+     fMatToyMode (kFALSE),
+     fHaveSVD    (kFALSE),
+     fTau        (0)
 {
    // Default constructor
    // Initialisation of TSVDUnfold
@@ -188,7 +193,15 @@ TSVDUnfold::TSVDUnfold( const TSVDUnfold& other )
      fToyhisto   (other.fToyhisto),
      fToymat     (other.fToymat),
      fToyMode    (other.fToyMode),
-     fMatToyMode (other.fMatToyMode) 
+     fMatToyMode (other.fMatToyMode),
+     fHaveSVD    (other.fHaveSVD),
+     fTau        (other.fTau),
+     fCurv       (other.fCurv),
+     fVreg       (other.fVreg),
+     fUTQ        (other.fUTQ),
+     fASV        (other.fASV),
+     fXiniV      (other.fXiniV),
+     fXinvM      (other.fXinvM)
 {
    // Copy constructor
 }
@@ -238,29 +251,46 @@ TH1D* TSVDUnfold::Unfold( Int_t kreg )
 {
    // Perform the unfolding with regularisation parameter kreg
    fKReg = kreg;
-   
-   // Make the histos
-   if (!fToyMode && !fMatToyMode) InitHistos( );
+   if (fMatToyMode || !fHaveSVD) Decompose();
 
-   // Create vectors and matrices
-   TVectorD vb(fNdim), vbini(fNdim), vxini(fNdim), vberr(fNdim);
-   TMatrixD mB(fNdim, fNdim), mA(fNdim, fNdim), mCurv(fNdim, fNdim), mC(fNdim, fNdim);
+   // Damping coefficient
+   Int_t k = GetKReg()-1; 
+   return DoUnfold( fASV(k)*fASV(k) );
+}
 
-   Double_t eps = 1e-12;
-   Double_t sreg;
+//_______________________________________________________________________
+TH1D* TSVDUnfold::UnfoldTau( Double_t tau )
+{
+   // Perform the unfolding with continuous regularisation parameter tau
+   fKReg = -1;
+   if (fMatToyMode || !fHaveSVD) Decompose();
+   return DoUnfold( tau );
+}
 
-   // Copy histogams entries into vector
-   if (fToyMode) { H2V( fToyhisto, vb ); H2Verr( fToyhisto, vberr ); }
-   else          { H2V( fBdat,     vb ); H2Verr( fBdat,     vberr ); }
+//_______________________________________________________________________
+TH1D* TSVDUnfold::UnfoldToy( )
+{
+   // Unfold a toy with the regularisation of the last unfolding
+   if (fKReg > 0) return Unfold( fKReg );
+   return UnfoldTau( fTau );
+}
+
+//_______________________________________________________________________
+void TSVDUnfold::Decompose( )
+{
+   // Decompositions of the response and the data covariance matrix, which do not depend on
+   // the regularisation or the measured spectrum. Kept for all unfoldings except response matrix toys.
+   TMatrixD mB(fNdim, fNdim), mA(fNdim, fNdim), mC(fNdim, fNdim);
+   fCurv.ResizeTo(fNdim, fNdim);
+   fXiniV.ResizeTo(fNdim);
 
    H2M( fBcov, mB);
-   H2V( fBini, vbini );
-   H2V( fXini, vxini );
+   H2V( fXini, fXiniV );
    if (fMatToyMode) H2M( fToymat, mA );
    else        H2M( fAdet,   mA );
 
    // Fill and invert the second derivative matrix
-   FillCurvatureMatrix( mCurv, mC );
+   FillCurvatureMatrix( fCurv, mC );
 
    // Inversion of mC by help of SVD
    TDecompSVD CSVD(mC);
@@ -274,115 +304,126 @@ TH1D* TSVDUnfold::Unfold( Int_t kreg )
    CUort.Transpose( CUort );
    TMatrixD mCinv = (CVort*CSVM)*CUort;
 
-   //Rescale using the data covariance matrix
+   //Rescale using the data covariance matrix: A -> Q^T A / sqrt(B), with rows of zero singular values dropped
    TDecompSVD BSVD( mB );
    TMatrixD QT = BSVD.GetU();
    QT.Transpose(QT);
    TVectorD B2SV = BSVD.GetSig();
-   TVectorD BSV(B2SV);
 
    for(int i=0; i<fNdim; i++){
-     BSV(i) = TMath::Sqrt(B2SV(i));
-   }
-   TMatrixD mAtmp(fNdim,fNdim);
-   TVectorD vbtmp(fNdim);
-   mAtmp *= 0;
-   vbtmp *= 0;
-   for(int i=0; i<fNdim; i++){
+     Double_t BSV = TMath::Sqrt(B2SV(i));
      for(int j=0; j<fNdim; j++){
-       if(BSV(i)){
-  	 vbtmp(i) += QT(i,j)*vb(j)/BSV(i);
-       }
-       for(int m=0; m<fNdim; m++){
- 	 if(BSV(i)){
- 	   mAtmp(i,j) += QT(i,m)*mA(m,j)/BSV(i);
- 	 }
-       }
+       if(BSV) QT(i,j) /= BSV;
+       else    QT(i,j)  = 0;
      }
    }
-   mA = mAtmp;
-   vb = vbtmp;
+   mA = QT*mA;
 
    // Singular value decomposition and matrix operations
    TDecompSVD ASVD( mA*mCinv );
-   TMatrixD Uort = ASVD.GetU();
-   TMatrixD Vort = ASVD.GetV();
-   TVectorD ASV  = ASVD.GetSig();
+   fASV.ResizeTo(fNdim);
+   fASV = ASVD.GetSig();
+   fVreg.ResizeTo(fNdim, fNdim);
+   fVreg.Mult( mCinv, ASVD.GetV() );
+   fUTQ.ResizeTo(fNdim, fNdim);
+   fUTQ.TMult( ASVD.GetU(), QT );
+
+   if (!fMatToyMode) {
+     // Inverse covariance matrix A^T A / (xini xini^T), independent of the regularisation
+     fXinvM.ResizeTo(fNdim, fNdim);
+     fXinvM.TMult( mA, mA );
+     for (Int_t i=0; i<fNdim; i++) {
+       for (Int_t j=0; j<fNdim; j++) {
+         if(fXiniV(i) && fXiniV(j))
+           fXinvM(i,j) /= fXiniV(i)*fXiniV(j);
+         else
+           fXinvM(i,j) = 0;
+       }
+     }
+   }
+
+   // Response matrix toys overwrite the decompositions
+   fHaveSVD = !fMatToyMode;
+}
+
+//_______________________________________________________________________
+TH1D* TSVDUnfold::DoUnfold( Double_t tau )
+{
+   // Unfold with the decompositions and damping factors s/(s^2+tau).
+   // The decompositions are made by the callers, Unfold and UnfoldTau.
+   fTau = tau;
 
+   // Make the histos
+   if (!fToyMode && !fMatToyMode) InitHistos( );
+
+   Double_t eps = 1e-12;
+   Double_t sreg;
+
+   // Copy histogams entries into vector
+   TVectorD vb(fNdim);
+   if (fToyMode) H2V( fToyhisto, vb );
+   else          H2V( fBdat,     vb );
+
+   const TVectorD& ASV = fASV;
    if (!fToyMode && !fMatToyMode) {
       V2H(ASV, *fSVHist);
    }
 
-   TMatrixD Vreg = mCinv*Vort;
-
-   Uort.Transpose(Uort);
-   TVectorD vd    = Uort*vb;
+   TVectorD vd = fUTQ*vb;
 
    if (!fToyMode && !fMatToyMode) {
       V2H(vd, *fDHist);
    }
 
-   // Damping coefficient
-   Int_t k = GetKReg()-1; 
-
    TVectorD vx(fNdim); // Return variable
 
    // Damping factors
    TVectorD vdz(fNdim);
-   TMatrixD Z(fNdim, fNdim);
    for (Int_t i=0; i<fNdim; i++) {
      if (ASV(i)<ASV(0)*eps) sreg = ASV(0)*eps;
      else                   sreg = ASV(i);
-     vdz(i) = sreg/(sreg*sreg + ASV(k)*ASV(k));
-     Z(i,i) = vdz(i)*vdz(i);
+     vdz(i) = sreg/(sreg*sreg + tau);
    }
    TVectorD vz = CompProd( vd, vdz );
-   
-   TMatrixD VortT(Vort);
-   VortT.Transpose(VortT);
-   TMatrixD W = mCinv*Vort*Z*VortT*mCinv;
-
-   TMatrixD Xtau(fNdim, fNdim);
-   TMatrixD Xinv(fNdim, fNdim);
-   Xtau *= 0;
-   Xinv *= 0;
-   for (Int_t i=0; i<fNdim; i++) {
-     for (Int_t j=0; j<fNdim; j++) {
-       Xtau(i,j) =  vxini(i) * vxini(j) * W(i,j);
-
-       double a=0;
-       for (Int_t m=0; m<fNdim; m++) {
-         a += mA(m,i)*mA(m,j);
-       }
-       if(vxini(i) && vxini(j))
-         Xinv(i,j) = a/vxini(i)/vxini(j);
-     }
-   }
 
    // Compute the weights
-   TVectorD vw = Vreg*vz;
+   TVectorD vw = fVreg*vz;
 
    // Rescale by xini
-   vx = CompProd( vw, vxini );
+   vx = CompProd( vw, fXiniV );
    
+   Double_t scale = 0;
    if(fNormalize){ // Scale result to unit area
-     Double_t scale = vx.Sum();
-     if (scale > 0){
-       vx *= 1.0/scale;
+     scale = vx.Sum();
+     if (scale > 0) vx *= 1.0/scale;
+   }
+
+   // Covariance matrices are not needed for toys
+   if (!fToyMode && !fMatToyMode) {
+     // W = Vreg*diag(vdz^2)*Vreg^T, a symmetric product
+     TVectorD vdz2 = CompProd( vdz, vdz );
+     TMatrixD W(fNdim, fNdim);
+     RooUnfold::ABAT( fVreg, vdz2, W );
+
+     TMatrixD Xtau(fNdim, fNdim);
+     for (Int_t i=0; i<fNdim; i++) {
+       for (Int_t j=0; j<fNdim; j++) {
+         Xtau(i,j) =  fXiniV(i) * fXiniV(j) * W(i,j);
+       }
+     }
+     TMatrixD Xinv = fXinvM;
+     if (scale > 0) {
        Xtau *= 1./scale/scale;
        Xinv *= scale*scale;
      }
-   }
 
-   if (!fToyMode && !fMatToyMode) {
-      M2H(Xtau, *fXtau);
-      M2H(Xinv, *fXinv);
-   }
-   
-   // Get Curvature and also chi2 in case of MC unfolding
-   if (!fToyMode && !fMatToyMode) {
-     Info( "Unfold", "Unfolding param: %i",k+1 );
-     Info( "Unfold", "Curvature of weight distribution: %f", GetCurvature( vw, mCurv ) );
+     M2H(Xtau, *fXtau);
+     M2H(Xinv, *fXinv);
+
+     // Get Curvature and also chi2 in case of MC unfolding
+     if (fKReg > 0) Info( "Unfold", "Unfolding param: %i", fKReg );
+     else           Info( "Unfold", "Unfolding param: tau=%g", tau );
+     Info( "Unfold", "Curvature of weight distribution: %f", GetCurvature( vw, fCurv ) );
    }
 
    TH1D* h = (TH1D*)fBdat->Clone("unfoldingresult");
@@ -459,7 +500,7 @@ TH2D* TSVDUnfold::GetUnfoldCovMatrix( const TH2D* cov, Int_t ntoys, Int_t seed )
          fToyhisto->SetBinError(j,fBdat->GetBinError(j));
       }
 
-      unfres = Unfold(GetKReg());
+      unfres = UnfoldToy();
 
       for (Int_t j=1; j<=fNdim; j++) {
          toymean->SetBinContent(j, toymean->GetBinContent(j) + unfres->GetBinContent(j)/ntoys);
@@ -486,7 +527,7 @@ TH2D* TSVDUnfold::GetUnfoldCovMatrix( const TH2D* cov, Int_t ntoys, Int_t seed )
          fToyhisto->SetBinContent( j, fBdat->GetBinContent(j)+g(j-1) );
          fToyhisto->SetBinError  ( j, fBdat->GetBinError(j) );
       }
-      unfres = Unfold(GetKReg());
+      unfres = UnfoldToy();
 
       for (Int_t j=1; j<=fNdim; j++) {
          for (Int_t k=1; k<=fNdim; k++) {
@@ -550,7 +591,7 @@ TH2D* TSVDUnfold::GetAdetCovMatrix( Int_t ntoys, Int_t seed, const TH2D* uncmat
          }
       }
 
-      unfres = Unfold(GetKReg());
+      unfres = UnfoldToy();
 
       for (Int_t j=1; j<=fNdim; j++) {
          toymean->SetBinContent(j, toymean->GetBinContent(j) + unfres->GetBinContent(j)/ntoys);
@@ -576,7 +617,7 @@ TH2D* TSVDUnfold::GetAdetCovMatrix( Int_t ntoys, Int_t seed, const TH2D* uncmat
          }
       }
 
-      unfres = Unfold(GetKReg());
+      unfres = UnfoldToy();
 
       for (Int_t j=1; j<=fNdim; j++) {
          for (Int_t k=1; k<=fNdim; k++) {
@@ -812,6 +853,7 @@ void TSVDUnfold::FillCurvatureMatrix( TMatrixD& tCurv, TMatrixD& tC ) const
 //_______________________________________________________________________
 void TSVDUnfold::InitHistos( )
 {
+   if (fDHist) return;   // already made by an earlier unfolding
 
    fDHist = new TH1D( "dd", "d vector after orthogonal transformation", fNdim, 0, fNdim );  
    fDHist->Sumw2();
@@ -81,6 +81,11 @@ public:
    // "kreg"   - number of singular values used (regularisation)
    TH1D*    Unfold       ( Int_t kreg );
 
+   // Do the unfolding with a continuous regularisation parameter
+   // "tau"    - damping of singular value s is s^2/(s^2+tau); Unfold(kreg) uses tau=s_kreg^2
+   // The decompositions are only done for the first unfolding, so scanning kreg or tau is cheap
+   TH1D*    UnfoldTau    ( Double_t tau );
+
    // Determine for given input error matrix covariance matrix of unfolded 
    // spectrum from toy simulation
    // "cov"    - covariance matrix on the measured spectrum, to be propagated
@@ -97,6 +102,7 @@ public:
 
    // Regularisation parameter
    Int_t    GetKReg() const { return fKReg; }
+   Double_t GetTau()  const { return fTau; }
 
    // Obtain the distribution of |d| (for determining the regularization)
    TH1D*    GetD() const;
@@ -123,6 +129,9 @@ private:
    static Double_t GetCurvature       ( const TVectorD& vec, const TMatrixD& curv );
 
    void            InitHistos  ( );
+   void            Decompose   ( );
+   TH1D*           DoUnfold    ( Double_t tau );
+   TH1D*           UnfoldToy   ( );
 
    // Helper functions
    static void     H2V      ( const TH1D* histo, TVectorD& vec   );
@@ -159,6 +168,15 @@ private:
    Bool_t      fToyMode;     //! Internal switch for covariance matrix propagation
    Bool_t      fMatToyMode;  //! Internal switch for evaluation of statistical uncertainties from response matrix
 
+   // Decompositions, independent of the regularisation and of the measured spectrum (but not its covariance)
+   Bool_t      fHaveSVD;     //! Decompositions below are for fAdet and fBcov
+   Double_t    fTau;         //! Regularisation parameter used in the last unfolding
+   TMatrixD    fCurv;        //! Curvature matrix
+   TMatrixD    fVreg;        //! C^-1 V, from the SVD U S V^T of the rescaled A C^-1
+   TMatrixD    fUTQ;         //! U^T Q^T / sqrt(B): maps the measured spectrum to d
+   TVectorD    fASV;         //! Singular values of the rescaled A C^-1
+   TVectorD    fXiniV;       //! Truth MC distribution
+   TMatrixD    fXinvM;       //! Inverse covariance matrix, before normalisation
    
    ClassDef( TSVDUnfold, 0 ) // Data unfolding using Singular Value Decomposition (hep-ph/9509307)   
 };
@@ -10,7 +10,7 @@ bool _ak7 = true;
 
 // From Sanmay by email 30 Mar 2015
 // (direct recommendations from different eta bins => not ideal?)
-const double kpar[6][2] = {
+constexpr double kpar[6][2] = {
   {1.079, 0.026},
   {1.099, 0.028},
   {1.121, 0.029},
@@ -23,7 +23,7 @@ const double kpar[6][2] = {
 // (produced on iMac desktop, with ROOT 5.30/00, iterating with AK5+2sigma)
 // On Sep 15, 2014, using Winter14_V5 private pre-version (root tuples v12)
 // Fit of JER for R=0.5, 8 TeV, 53X
-const double vpar5[6][3] =
+constexpr double vpar5[6][3] =
   {{3.13, 0.897, 0.0337},  // y 0.0-0.5, chi2 21.6/33
    {3.58, 0.868, 0.0376},  // y 0.5-1.0, chi2 12.9/33
    {4.78, 0.885, 0.0438},  // y 1.0-1.5, chi2 26.5/33
@@ -32,7 +32,7 @@ const double vpar5[6][3] =
    {2.86, 0.874, 0.0000}}; // y 2.5-3.0, chi2 10.8/19
 
 // Fit of JER for R=0.7, 8 TeV, 53X
-const double vpar7[6][3] =
+constexpr double vpar7[6][3] =
   // values from Sanmay by email 30 Mar 2015
   {{5.79356, 0.984061, 0.0290218},
    {6.10575, 0.952320, 0.0328014},
@@ -41,20 +41,70 @@ const double vpar7[6][3] =
    {6.06794, 0.734516, 0.00}, //1.31400e-05},
    {4.57993, 0.853656, 0.00}};//1.30360e-06}};
 
+// Relative jet pT resolution, sqrt((p0/pt)^2 + p1^2/pt + p2^2) per rapidity
+// bin, with the data/MC scale factor kpar for data: the parameter set is
+// picked at compile time and the squared coefficients, including the scale
+// factor, are cached per rapidity bin once
+enum jer_algo { jer_ak5, jer_ak7 };
 
-double ptresolution(double pt, double eta) {
+template<jer_algo A> struct jer_table;
+template<> struct jer_table<jer_ak5> {
+  static const double (*par())[3] { return vpar5; }
+};
+template<> struct jer_table<jer_ak7> {
+  static const double (*par())[3] { return vpar7; }
+};
+
+class jer_model {
+
+public:
+
+  jer_model() { set<jer_ak7>(true); }
+  jer_model(bool ak7, bool ismc) { set(ak7, ismc); }
+
+  template<jer_algo A> void set(bool ismc) {
+    const double (*v)[3] = jer_table<A>::par();
+    for (int iy = 0; iy != 6; ++iy) {
+      double k2 = (ismc ? 1 : kpar[iy][0]*kpar[iy][0]);
+      _c[iy][0] = k2 * v[iy][0]*v[iy][0];
+      _c[iy][1] = k2 * v[iy][1]*v[iy][1];
+      _c[iy][2] = k2 * v[iy][2]*v[iy][2];
+    }
+  }
+  void set(bool ak7, bool ismc) {
+    if (ak7) set<jer_ak7>(ismc);
+    else     set<jer_ak5>(ismc);
+  }
 
-  int iy = min(5, int(fabs(eta) / 0.5 + 0.5));
-  double res = 0;
-  if (_ak7)
-    res = sqrt(pow(vpar7[iy][0]/pt,2) + pow(vpar7[iy][1],2)/pt + 
-	       pow(vpar7[iy][2],2));
-  else
-    res = sqrt(pow(vpar5[iy][0]/pt,2) + pow(vpar5[iy][1],2)/pt + 
-	       pow(vpar5[iy][2],2));
-  if (!_ismcjer) res *= kpar[iy][0];
+  static int ybin(double eta) { return min(5, int(fabs(eta) / 0.5 + 0.5)); }
 
-  return res;
-}
+  // Relative resolution at a single point
+  double operator()(double pt, double eta) const {
+    const double *c = _c[ybin(eta)];
+    return sqrt(c[0]/(pt*pt) + c[1]/pt + c[2]);
+  }
+
+  // Batch evaluation for a node set at fixed rapidity (quadrature)
+  void eval(int n, const double *pt, double eta, double *res) const {
+    const double *c = _c[ybin(eta)];
+    for (int i = 0; i != n; ++i) {
+      const double u = 1. / pt[i];
+      res[i] = sqrt((c[0]*u + c[1])*u + c[2]);
+    }
+  }
+
+  // Batch evaluation for arbitrary (pt, eta) pairs
+  void eval(int n, const double *pt, const double *eta, double *res) const {
+    for (int i = 0; i != n; ++i) {
+      const double *c = _c[ybin(eta[i])];
+      const double u = 1. / pt[i];
+      res[i] = sqrt((c[0]*u + c[1])*u + c[2]);
+    }
+  }
+
+private:
+
+  double _c[6][3]; // squared (p0, p1, p2) per rapidity bin, JER SF included
+};
 
 #endif // __ptresolution_h__
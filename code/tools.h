@@ -38,6 +38,26 @@ namespace tools {
   TH1D *Rebin(const TH1D *h, const TH1D* href);
 
   void Hadd(TH1 *h1, TH1 *h2, double ptmax=0, bool syserr = false);
+
+  // Bin centering for the NLO ansatz
+  // f(x) = p0*exp(p1/x)*pow(x,p2)*pow(1-x*cosh(p4)/emax,p3)
+  // Returns x in [xmin,xmax] where f(x) equals the bin average of f,
+  // memoized per (bin edges, parameters)
+  double ansatzIntegral(const double *p, double emax, double xmin, double xmax);
+  double binCenter(const double *p, double emax, double xmin, double xmax);
+  double binCenter(TF1 *f, double xmin, double xmax, double emax = 0);
+
+  // Levenberg-Marquardt fit of the NLO ansatz above to histogram bins or
+  // graph points inside the range of f, with p4 (rapidity) and p5 (emax)
+  // fixed. Fits in log(p0) with analytic Jacobian, warm-starts from the
+  // previous fit and caches results per input data. With fewer than 5
+  // points, warns and fits min(n,4) of p0, p2, p3, p1 in that order, keeping
+  // the rest. Returns chi2, or -1 without changing f if there are no points
+  double fitAnsatz(TH1 *h, TF1 *f, double emax = 0);
+  double fitAnsatz(TGraphErrors *g, TF1 *f, double emax = 0);
+  // Clear the memoized bin centers and fits, and the warm start, which
+  // otherwise grow with every new fit: call once a set of spectra is done
+  void clearAnsatzCache();
 } // namespace tools
 
 #endif